@@ -17,6 +17,13 @@
 #include <boost/utility.hpp>
 #include <iterator>
 #include <utility> // for std::pair
+#include <map>
+#include <tuple>
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
 
 /// exception thrown when the alsa wrapper encounters an underlying alsa error.
 class alsa_exception: public std::exception
@@ -37,11 +44,12 @@ private:
 };
 
 /// internally used function to throw an exception whenever an alsa api function returns an error.
-int throw_if_error(int returnvalue)
+template<typename T>
+T throw_if_error(T returnvalue)
 {
 	if (returnvalue < 0)
 	{
-		throw alsa_exception(returnvalue);
+		throw alsa_exception(static_cast<int>(returnvalue));
 	}
 
 	return returnvalue;
@@ -167,6 +175,7 @@ private:
 #define ALSA_OBJECT_WRAPPER( objecttype) alsa_object_wrapper<objecttype##_t, objecttype##_malloc, objecttype##_free>;
 using snd_ctl_card_info_wrapper = ALSA_OBJECT_WRAPPER(snd_ctl_card_info);
 using snd_pcm_hw_params_wrapper = ALSA_OBJECT_WRAPPER( snd_pcm_hw_params);
+using snd_pcm_sw_params_wrapper = ALSA_OBJECT_WRAPPER( snd_pcm_sw_params);
 
 
 #define IMPLEMENT_PARAM( name)    \
@@ -180,18 +189,134 @@ using snd_pcm_hw_params_wrapper = ALSA_OBJECT_WRAPPER( snd_pcm_hw_params);
         }\
         /**/
 
+#define IMPLEMENT_SW_PARAM( name)    \
+        void name( typename parameter_type<decltype(snd_pcm_sw_params_set_##name)>::type val) \
+        {                               \
+            set( snd_pcm_sw_params_set_##name, val);\
+        }\
+        typename parameter_type<decltype(snd_pcm_sw_params_set_##name)>::type name() const\
+        {\
+            return get( snd_pcm_sw_params_get_##name);\
+        }\
+        /**/
+
+/// When a prepared pcm device starts playing the frames that are written to it.
+enum class pcm_start_profile
+{
+    buffered,   ///< start once the ring buffer is full, or when playing is started explicitly
+    fast_start  ///< start as soon as the first period has been written
+};
+
+/// The hardware parameters that a pcm device is set up with.
+struct pcm_configuration
+{
+    snd_pcm_format_t    format;
+    unsigned int        rate;
+    unsigned int        channels;
+    snd_pcm_uframes_t   period_size;    ///< frames per period, or 0 for the buffering that the device is set up with
+    snd_pcm_uframes_t   buffer_size;    ///< frames in the ring buffer, or 0 for the buffering that the device is set up with
+
+    bool operator==( const pcm_configuration &other) const
+    {
+        return as_tuple() == other.as_tuple();
+    }
+
+    bool operator<( const pcm_configuration &other) const
+    {
+        return as_tuple() < other.as_tuple();
+    }
+
+private:
+    std::tuple<int, unsigned int, unsigned int, snd_pcm_uframes_t, snd_pcm_uframes_t> as_tuple() const
+    {
+        return std::make_tuple( format, rate, channels, period_size, buffer_size);
+    }
+};
+
+/// RAII wrapper around a part of the ring buffer of a pcm device that was obtained with snd_pcm_mmap_begin().
+/// Frames that have been written into the area are handed to the device with commit(). An area that is
+/// destroyed without having been committed is committed with zero frames, to end the access.
+/// Only interleaved access is supported: all samples of a frame are assumed to be adjacent.
+class pcm_mmap_area : boost::noncopyable
+{
+public:
+    pcm_mmap_area( snd_pcm_t *handle, snd_pcm_uframes_t framecount)
+    :handle( handle), framecount( framecount)
+    {
+        const snd_pcm_channel_area_t *areas = nullptr;
+        throw_if_error( snd_pcm_mmap_begin( handle, &areas, &offset, &this->framecount));
+        start = static_cast<char *>( areas[0].addr) + (areas[0].first + offset * areas[0].step) / 8;
+    }
+
+    pcm_mmap_area( pcm_mmap_area &&other)
+    :handle( other.handle), start( other.start), offset( other.offset), framecount( other.framecount), committed( other.committed)
+    {
+        other.committed = true;
+    }
+
+    ~pcm_mmap_area()
+    {
+        if (!committed) snd_pcm_mmap_commit( handle, offset, 0);
+    }
+
+    /// address of the first frame of this area.
+    char *data() const
+    {
+        return start;
+    }
+
+    /// number of frames that may be written in this area.
+    snd_pcm_uframes_t frames() const
+    {
+        return framecount;
+    }
+
+    /// Hand the first 'count' frames of this area over to the device.
+    snd_pcm_uframes_t commit( snd_pcm_uframes_t count)
+    {
+        committed = true;
+        return throw_if_error( snd_pcm_mmap_commit( handle, offset, count));
+    }
+
+private:
+    snd_pcm_t         *handle;
+    char              *start = nullptr;
+    snd_pcm_uframes_t offset = 0;
+    snd_pcm_uframes_t framecount;
+    bool              committed = false;
+};
+
+/// Counters that show how often a pcm device had to be set up.
+struct pcm_statistics
+{
+    unsigned long reconfigurations; ///< number of times that hardware parameters were committed to the device.
+    unsigned long negotiations;     ///< number of times that hardware parameters had to be negotiated from scratch.
+    unsigned long reuses;           ///< number of times that the device could be used as it was configured.
+    unsigned long underruns;        ///< number of times that the device ran out of frames while playing.
+};
+
+/// Period and buffer size that a pcm device uses for configurations that don't specify them.
+/// A buffer size of 0 lets the device choose its buffer size.
+struct pcm_buffering
+{
+    snd_pcm_uframes_t   period_size;
+    snd_pcm_uframes_t   buffer_size;
+};
 
 class opened_pcm_device
 {
 public:
-    opened_pcm_device( int cardnumber, int devicenumber, snd_pcm_stream_t stream)
-    :handle( open(cardnumber,devicenumber, stream), snd_pcm_close)
+    /// Open a pcm device. Normally, the device is opened through the alsa plug layer, which converts
+    /// any sample format to one that the hardware supports. If 'raw' is true, the hardware device is opened
+    /// directly and only the formats of the hardware itself can be played.
+    opened_pcm_device( int cardnumber, int devicenumber, snd_pcm_stream_t stream, bool raw = false)
+    :handle( open(cardnumber,devicenumber, stream, raw), snd_pcm_close)
     {
         snd_pcm_hw_params_any( handle.get(), hw_params.get());
     }
 
-    opened_pcm_device( std::pair<int, int> deviceid, snd_pcm_stream_t stream)
-    :opened_pcm_device( deviceid.first, deviceid.second, stream) {}
+    opened_pcm_device( std::pair<int, int> deviceid, snd_pcm_stream_t stream, bool raw = false)
+    :opened_pcm_device( deviceid.first, deviceid.second, stream, raw) {}
 
     template<typename V>
     struct parameter_type {};
@@ -214,32 +339,422 @@ public:
     IMPLEMENT_PARAM( rate)
     IMPLEMENT_PARAM( period_size)
     IMPLEMENT_PARAM( period_time)
+    IMPLEMENT_PARAM( buffer_size)
+
+    IMPLEMENT_SW_PARAM( start_threshold)
+    IMPLEMENT_SW_PARAM( stop_threshold)
+    IMPLEMENT_SW_PARAM( avail_min)
+    IMPLEMENT_SW_PARAM( silence_threshold)
+    IMPLEMENT_SW_PARAM( silence_size)
 
     void commit_parameters()
     {
         throw_if_error(snd_pcm_hw_params( get_handle(), get_params()));
     }
 
-    void writei( char *buffer, size_t framecount)
+    /// Commit the software parameters that were set with the software parameter functions, like start_threshold().
+    /// Committing hardware parameters resets the software parameters of a device to their defaults, so the software
+    /// parameters must be set and committed after the hardware parameters.
+    void commit_software_parameters()
+    {
+        throw_if_error( snd_pcm_sw_params( get_handle(), get_sw_params()));
+    }
+
+    /// Select when the device starts playing. This takes effect when the device is configured for a new
+    /// configuration.
+    void set_start_profile( pcm_start_profile profile)
+    {
+        start_profile = profile;
+        configured = false;
+    }
+
+    /// Make sure that the device is set up with the given configuration and ready to play.
+    /// Period and buffer sizes that the configuration leaves at 0 are taken from the buffering of the device.
+    /// Hardware parameters that were committed before are remembered, so the device only needs
+    /// to be reconfigured if the configuration differs from the current one and is only negotiated
+    /// from scratch if the configuration was never used before.
+    /// If mmap transfers are enabled, mmap access is negotiated, falling back to read/write access if
+    /// the device refuses mmap.
+    /// Returns true if the device had to be reconfigured.
+    bool configure( const pcm_configuration &requested)
+    {
+        pcm_configuration config = requested;
+        if (!config.period_size) config.period_size = buffering.period_size;
+        if (!config.buffer_size) config.buffer_size = buffering.buffer_size;
+
+        if (configured && config == current)
+        {
+            ++reuse_count;
+            // a running device is in the middle of a stream that the caller appends to.
+            const auto state = snd_pcm_state( get_handle());
+            if (state != SND_PCM_STATE_PREPARED && state != SND_PCM_STATE_RUNNING) prepare();
+            return false;
+        }
+
+        auto cached = configurations.find( config);
+        if (cached == configurations.end())
+        {
+            throw_if_error( snd_pcm_hw_params_any( get_handle(), get_params()));
+            if (!mmap_enabled ||
+                    snd_pcm_hw_params_set_access( get_handle(), get_params(), SND_PCM_ACCESS_MMAP_INTERLEAVED) < 0)
+            {
+                access( SND_PCM_ACCESS_RW_INTERLEAVED);
+            }
+            format( config.format);
+            rate( {config.rate, 0});
+            channels( config.channels);
+            period_size( {config.period_size, 0});
+            if (config.buffer_size) buffer_size( config.buffer_size);
+            commit_parameters();
+
+            snd_pcm_hw_params_wrapper committed;
+            snd_pcm_hw_params_copy( committed.get(), get_params());
+            configurations.insert( std::make_pair( config, committed));
+            ++negotiation_count;
+        }
+        else
+        {
+            snd_pcm_hw_params_copy( get_params(), cached->second.get());
+            commit_parameters();
+        }
+
+        apply_start_profile();
+        ++reconfiguration_count;
+        current = config;
+        configured = true;
+        mmap_access = access() == SND_PCM_ACCESS_MMAP_INTERLEAVED;
+        frame_size = snd_pcm_format_physical_width( config.format) / 8 * config.channels;
+        const snd_pcm_uframes_t period = period_size().first;
+        silence.resize( period * frame_size);
+        snd_pcm_format_set_silence( config.format, silence.data(), period * config.channels);
+        return true;
+    }
+
+    /// returns whether the device is currently set up with the given configuration.
+    bool has_configuration( const pcm_configuration &requested) const
+    {
+        pcm_configuration config = requested;
+        if (!config.period_size) config.period_size = buffering.period_size;
+        if (!config.buffer_size) config.buffer_size = buffering.buffer_size;
+        return configured && config == current;
+    }
+
+    /// Find the sample format, sample rate and number of channels that the hardware plays without any conversion.
+    /// Of the formats that cheapl can convert waveforms to, 16-bit samples are preferred, then mono, then the
+    /// given sample rate, then 48kHz and 44.1kHz. Period and buffer size are left at 0.
+    pcm_configuration native_configuration( unsigned int preferred_rate) const
+    {
+        snd_pcm_hw_params_wrapper params;
+        throw_if_error( snd_pcm_hw_params_any( get_handle(), params.get()));
+
+        pcm_configuration result{ SND_PCM_FORMAT_UNKNOWN, 0, 0, 0, 0};
+        for (auto format : {SND_PCM_FORMAT_S16_LE, SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_U8})
+        {
+            if (snd_pcm_hw_params_test_format( get_handle(), params.get(), format) == 0)
+            {
+                result.format = format;
+                break;
+            }
+        }
+        if (result.format == SND_PCM_FORMAT_UNKNOWN) throw alsa_exception( -EINVAL);
+        throw_if_error( snd_pcm_hw_params_set_format( get_handle(), params.get(), result.format));
+
+        for (auto channels : {1u, 2u})
+        {
+            if (snd_pcm_hw_params_test_channels( get_handle(), params.get(), channels) == 0)
+            {
+                result.channels = channels;
+                break;
+            }
+        }
+        if (!result.channels) throw_if_error( snd_pcm_hw_params_get_channels_min( params.get(), &result.channels));
+        throw_if_error( snd_pcm_hw_params_set_channels( get_handle(), params.get(), result.channels));
+
+        for (auto rate : {preferred_rate, 48000u, 44100u})
+        {
+            if (snd_pcm_hw_params_test_rate( get_handle(), params.get(), rate, 0) == 0)
+            {
+                result.rate = rate;
+                break;
+            }
+        }
+        if (!result.rate)
+        {
+            result.rate = preferred_rate;
+            throw_if_error( snd_pcm_hw_params_set_rate_near( get_handle(), params.get(), &result.rate, nullptr));
+        }
+        return result;
+    }
+
+    /// Set the period and buffer size for configurations that don't specify them. This takes effect
+    /// the next time that the device is configured.
+    void set_buffering( const pcm_buffering &new_buffering)
+    {
+        buffering = new_buffering;
+        configured = false;
+    }
+
+    pcm_buffering get_buffering() const
+    {
+        return buffering;
+    }
+
+    /// Write 'framecount' frames of silence to the device.
+    void write_silence( snd_pcm_uframes_t framecount)
+    {
+        const snd_pcm_uframes_t period = silence.size() / frame_size;
+        while (framecount)
+        {
+            const auto count = std::min( period, framecount);
+            write( silence.data(), count);
+            framecount -= count;
+        }
+    }
+
+    /// returns the number of frames that have been written, but not yet played.
+    snd_pcm_sframes_t delay()
+    {
+        snd_pcm_sframes_t frames = 0;
+        if (snd_pcm_delay( get_handle(), &frames) < 0) return 0;
+        return frames;
+    }
+
+    /// Determine whether configure() should try to negotiate mmap access.
+    /// This only has effect on configurations that weren't used before.
+    void enable_mmap( bool enable)
     {
-        snd_pcm_writei( get_handle(), buffer, framecount);
+        mmap_enabled = enable;
+    }
+
+    /// returns whether the current configuration uses mmap access.
+    bool uses_mmap() const
+    {
+        return mmap_access;
+    }
+
+    /// Obtain an area of the ring buffer that up to 'framecount' frames can be written to directly.
+    pcm_mmap_area mmap_begin( snd_pcm_uframes_t framecount)
+    {
+        return pcm_mmap_area{ get_handle(), framecount};
+    }
+
+    /// Write all given interleaved frames to the device, using the access method of the current configuration.
+    /// This function blocks until all frames have been handed to the device. With mmap access the frames
+    /// are copied directly into the ring buffer of the device.
+    void write( const char *buffer, snd_pcm_uframes_t framecount)
+    {
+        if (!mmap_access)
+        {
+            while (framecount)
+            {
+                const auto written = snd_pcm_writei( get_handle(), buffer, framecount);
+                if (written < 0)
+                {
+                    // recover from underruns, which happen when the device runs dry between two writes.
+                    recover( static_cast<int>( written));
+                    continue;
+                }
+                buffer += written * frame_size;
+                framecount -= written;
+            }
+            return;
+        }
+
+        const auto size = frame_size;
+        mmap_write( framecount,
+                [buffer, size]( char *destination, snd_pcm_uframes_t offset, snd_pcm_uframes_t count)
+                {
+                    std::memcpy( destination, buffer + offset * size, count * size);
+                });
+    }
+
+    /// Write 'framecount' frames that are produced by a generator function to the device.
+    /// The generator is called as generator( destination, offset, count) and should write the 'count' frames that
+    /// start at frame 'offset' to destination. With mmap access, the generator writes directly into the ring buffer
+    /// of the device, otherwise it writes into a buffer of one period that is then written to the device.
+    template<typename Generator>
+    void write_generated( snd_pcm_uframes_t framecount, Generator generator)
+    {
+        if (mmap_access)
+        {
+            mmap_write( framecount, generator);
+            return;
+        }
+
+        const snd_pcm_uframes_t period = silence.size() / frame_size;
+        staging.resize( silence.size());
+        for (snd_pcm_uframes_t offset = 0; offset < framecount; offset += period)
+        {
+            const auto count = std::min( period, framecount - offset);
+            generator( staging.data(), offset, count);
+            write( staging.data(), count);
+        }
+    }
+
+    /// Start the device if it is prepared but not yet running.
+    void start()
+    {
+        if (snd_pcm_state( get_handle()) == SND_PCM_STATE_PREPARED)
+        {
+            throw_if_error( snd_pcm_start( get_handle()));
+        }
+    }
+
+    /// Switch the device between blocking and non-blocking mode.
+    /// In non-blocking mode, writes return immediately when the ring buffer is full and the device should
+    /// be polled through its poll descriptors to find out when it can accept more frames.
+    void set_nonblocking( bool nonblocking)
+    {
+        throw_if_error( snd_pcm_nonblock( get_handle(), nonblocking ? 1 : 0));
+    }
+
+    /// return the file descriptors that should be polled to wait for the device to accept frames.
+    std::vector<pollfd> poll_descriptors() const
+    {
+        std::vector<pollfd> descriptors( throw_if_error( snd_pcm_poll_descriptors_count( get_handle())));
+        throw_if_error( snd_pcm_poll_descriptors( get_handle(), descriptors.data(), descriptors.size()));
+        return descriptors;
+    }
+
+    /// Translate the events that poll() returned for the poll descriptors of this device into device events,
+    /// like POLLOUT when the device can accept frames.
+    unsigned short poll_revents( std::vector<pollfd> &descriptors) const
+    {
+        unsigned short events = 0;
+        throw_if_error( snd_pcm_poll_descriptors_revents( get_handle(), descriptors.data(), descriptors.size(), &events));
+        return events;
+    }
+
+    /// return the number of frames that can be written to the device without blocking.
+    /// This recovers the device if it suffered an underrun.
+    snd_pcm_uframes_t available()
+    {
+        for (;;)
+        {
+            const auto frames = snd_pcm_avail_update( get_handle());
+            if (frames >= 0) return frames;
+            recover( static_cast<int>( frames));
+        }
+    }
+
+    /// Write interleaved frames to a device in non-blocking mode.
+    /// Returns the number of frames that the device accepted, which is zero if the ring buffer is full or
+    /// if the device had to recover from an underrun.
+    snd_pcm_uframes_t try_write( const char *buffer, snd_pcm_uframes_t framecount)
+    {
+        const auto written = snd_pcm_writei( get_handle(), buffer, framecount);
+        if (written == -EAGAIN) return 0;
+        if (written < 0)
+        {
+            recover( static_cast<int>( written));
+            return 0;
+        }
+        return written;
+    }
+
+    /// Write up to a period of silence to a device in non-blocking mode.
+    /// Returns the number of frames that the device accepted.
+    snd_pcm_uframes_t try_write_silence( snd_pcm_uframes_t framecount)
+    {
+        return try_write( silence.data(), std::min<snd_pcm_uframes_t>( framecount, silence.size() / frame_size));
+    }
+
+    /// return the configuration counters of this device.
+    /// This function may be called from another thread than the one that plays to the device.
+    pcm_statistics statistics() const
+    {
+        return { reconfiguration_count, negotiation_count, reuse_count, underrun_count};
+    }
+
+    /// write interleaved frames to the device, returns the number of frames actually written.
+    snd_pcm_uframes_t writei( const char *buffer, snd_pcm_uframes_t framecount)
+    {
+        return throw_if_error( snd_pcm_writei( get_handle(), buffer, framecount));
     }
 
     void drain()
     {
         snd_pcm_drain( get_handle());
     }
+
+    /// Stop playing immediately, discarding the frames that weren't played yet, and prepare the device
+    /// for a new stream.
+    void drop()
+    {
+        snd_pcm_drop( get_handle());
+        prepare();
+    }
+
+    /// Prepare the device for playing, so that the next write starts immediately.
+    void prepare()
+    {
+        throw_if_error( snd_pcm_prepare( get_handle()));
+    }
 private:
 
-    static snd_pcm_t *open( int cardnumber, int devicenumber, snd_pcm_stream_t stream)
+    static snd_pcm_t *open( int cardnumber, int devicenumber, snd_pcm_stream_t stream, bool raw)
     {
         snd_pcm_t *handle = nullptr;
         using std::to_string;
-        const std::string devicename = "plughw:" + to_string(cardnumber) + ","+ to_string( devicenumber);
+        const std::string devicename = (raw ? "hw:" : "plughw:") + to_string(cardnumber) + ","+ to_string( devicenumber);
         throw_if_error(snd_pcm_open( &handle, devicename.c_str(), stream, 0));
         return handle;
     }
 
+    /// Bring the device back into a state where it can be written to after a failed transfer.
+    void recover( int error)
+    {
+        if (error == -EPIPE) ++underrun_count;
+        throw_if_error( snd_pcm_recover( get_handle(), error, 1));
+    }
+
+    /// Set the software parameters of the current hardware configuration according to the start profile.
+    /// With the fast start profile, the device starts playing after the first period, so that the first samples
+    /// reach the transmitter without waiting for the ring buffer to fill up.
+    void apply_start_profile()
+    {
+        throw_if_error( snd_pcm_sw_params_current( get_handle(), get_sw_params()));
+        const snd_pcm_uframes_t period = period_size().first;
+        const snd_pcm_uframes_t buffer = buffer_size();
+        start_threshold( start_profile == pcm_start_profile::fast_start ? period : buffer);
+        stop_threshold( buffer);
+        avail_min( period);
+        commit_software_parameters();
+    }
+
+    /// Let a generator write frames directly into the ring buffer of a device with mmap access.
+    template<typename Generator>
+    void mmap_write( snd_pcm_uframes_t framecount, Generator generator)
+    {
+        const snd_pcm_uframes_t period = period_size().first;
+        snd_pcm_uframes_t offset = 0;
+        while (offset < framecount)
+        {
+            const auto available = snd_pcm_avail_update( get_handle());
+            if (available < 0)
+            {
+                recover( static_cast<int>( available));
+                continue;
+            }
+
+            const auto writable = std::min<snd_pcm_uframes_t>( available, framecount - offset);
+            if (writable < period && writable < framecount - offset)
+            {
+                // the ring buffer is full, make sure the device is playing and wait for room.
+                start();
+                snd_pcm_wait( get_handle(), -1);
+                continue;
+            }
+
+            auto area = mmap_begin( writable);
+            generator( area.data(), offset, area.frames());
+            offset += area.commit( area.frames());
+        }
+
+        // short waveforms may not have filled the buffer far enough to start the device.
+        start();
+    }
+
     template<typename T>
     void set( int (*set_func)(snd_pcm_t *, snd_pcm_hw_params_t *, T ), T value)
     {
@@ -252,6 +767,20 @@ private:
         throw_if_error( set_func(get_handle(), get_params(), value.first, value.second));
     }
 
+    template<typename T>
+    void set( int (*set_func)(snd_pcm_t *, snd_pcm_sw_params_t *, T ), T value)
+    {
+        throw_if_error( set_func(get_handle(), get_sw_params(), value));
+    }
+
+    template< typename T>
+    T get( int (*get_func)(const snd_pcm_sw_params_t *, T *)) const
+    {
+        T value;
+        throw_if_error( get_func( get_sw_params(), &value));
+        return value;
+    }
+
     template< typename T>
     T get( int (*get_func)(const snd_pcm_hw_params_t *, T *)) const
     {
@@ -278,8 +807,30 @@ private:
         return hw_params.get();
     }
 
+    snd_pcm_sw_params_t *get_sw_params() const
+    {
+        return sw_params.get();
+    }
+
+    using configuration_map = std::map<pcm_configuration, snd_pcm_hw_params_wrapper>;
+
     std::shared_ptr<snd_pcm_t>  handle;
     snd_pcm_hw_params_wrapper   hw_params;
+    snd_pcm_sw_params_wrapper   sw_params;
+    configuration_map           configurations; ///< hardware parameters of all configurations committed so far
+    pcm_configuration           current;        ///< configuration that the device is currently set up with
+    bool                        configured = false;
+    bool                        mmap_enabled = true;
+    bool                        mmap_access = false;  ///< whether the current configuration uses mmap access
+    pcm_start_profile           start_profile = pcm_start_profile::fast_start;
+    pcm_buffering               buffering{ 128, 0};   ///< period and buffer size for configurations that don't specify them
+    unsigned int                frame_size = 0;       ///< size in bytes of a frame in the current configuration
+    std::vector<char>           silence;              ///< one period of silence in the current configuration
+    std::vector<char>           staging;              ///< buffer for generated frames without mmap access
+    std::atomic<unsigned long>  reconfiguration_count{0};
+    std::atomic<unsigned long>  negotiation_count{0};
+    std::atomic<unsigned long>  reuse_count{0};
+    std::atomic<unsigned long>  underrun_count{0};
 };
 
 /// This class represents an opened alsa sound card.
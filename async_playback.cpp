@@ -0,0 +1,290 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "async_playback.h"
+#include "audio_sink.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+/// Create a player that plays to the given device from the thread that runs the given io_service.
+/// The device is switched to non-blocking mode. Its poll descriptors are obtained once, alsa devices keep
+/// the same descriptors for as long as they are open.
+async_playback::async_playback(
+        boost::asio::io_service &service, audio_sink &device, std::size_t capacity,
+        std::chrono::milliseconds gap, latency_statistics *latencies)
+:service( service), device( device), capacity( capacity), gap( gap), latencies( latencies),
+ poll_fds( device.poll_descriptors()), drain_timer( service), device_timer( service)
+{
+    device.set_nonblocking( true);
+    for (const auto &fd : poll_fds)
+    {
+        descriptors.emplace_back( new descriptor( service, fd.fd));
+    }
+}
+
+/// Stop watching the device. Jobs that are still waiting will not be played.
+async_playback::~async_playback()
+{
+    boost::system::error_code ignored;
+    drain_timer.cancel( ignored);
+    device_timer.cancel( ignored);
+    for (auto &d : descriptors)
+    {
+        d->cancel( ignored);
+        // the file descriptors belong to alsa, so they must not be closed here.
+        d->release();
+    }
+}
+
+/// Schedule a waveform to be played.
+/// Writing starts immediately, as far as the device has room for the frames, and continues whenever the
+/// device is ready for more. This function returns false if 'capacity' jobs are already waiting, in which
+/// case the job is discarded.
+bool async_playback::push( playback_job job)
+{
+    if (jobs.size() >= capacity) return false;
+    jobs.push_back( std::move( job));
+
+    if (draining)
+    {
+        // the new job may be appended to the stream that is still playing.
+        ++generation;
+        draining = false;
+        boost::system::error_code ignored;
+        drain_timer.cancel( ignored);
+    }
+    if (!waiting) pump();
+    return true;
+}
+
+/// Write frames to the device until it doesn't accept any more or until there is nothing left to write.
+/// In the first case, this function arranges to be called again once the device is ready. In the second case
+/// it waits for the device to play the rest of the stream.
+void async_playback::pump()
+{
+    try
+    {
+        for (;;)
+        {
+            if (!active && !start_next())
+            {
+                if (streaming) wait_for_drain();
+                return;
+            }
+
+            const auto available = device.available();
+            const auto written = available ? write_current( available) : 0;
+            if (!written && active)
+            {
+                wait_for_device();
+                return;
+            }
+        }
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "error while playing waveform: " << e.what() << std::endl;
+        active = false;
+        pause = 0;
+        remaining = 0;
+        ++generation;
+        waiting = false;
+        draining = false;
+        finish();
+        if (!jobs.empty()) service.post( [this](){ if (!waiting && !draining && !active) pump();});
+    }
+}
+
+/// Make the next waiting job the current one.
+/// Returns false if there is no job, or if the next job has a different format than the stream that is
+/// currently playing, in which case that stream needs to end first.
+bool async_playback::start_next()
+{
+    if (jobs.empty()) return false;
+
+    const auto config = configuration_from_wav( jobs.front().wav.fmt);
+    if (streaming)
+    {
+        if (!device.has_configuration( config)) return false;
+        pause = gap.count() * config.rate / 1000;
+    }
+
+    device.configure( config);
+    current = std::move( jobs.front());
+    jobs.pop_front();
+    position = 0;
+    remaining = current.repeats > 1 ? current.repeats - 1 : 0;
+    active = true;
+    if (!current.wav.samples) staging.resize( device.period_size() * current.wav.frame_size());
+    start_trace( current, latencies);
+    return true;
+}
+
+/// Write at most 'available' frames of the gap or of the current job to the device.
+/// Jobs with repeats are written from the same waveform again, after a gap of silence.
+/// Returns the number of frames that the device accepted.
+std::size_t async_playback::write_current( std::size_t available)
+{
+    std::size_t written = 0;
+    if (pause)
+    {
+        written = device.try_write_silence( std::min( pause, available));
+        pause -= written;
+    }
+    else
+    {
+        const auto &wav = current.wav;
+        const auto count = std::min( available, wav.frame_count() - position);
+        if (wav.samples)
+        {
+            written = device.try_write( wav.data() + position * wav.frame_size(), count);
+        }
+        else if (count)
+        {
+            const auto frames = std::min( count, staging.size() / wav.frame_size());
+            wav.render( staging.data(), position, frames);
+            written = device.try_write( staging.data(), frames);
+        }
+
+        position += written;
+        if (position >= wav.frame_count() && remaining)
+        {
+            // play the same waveform again, after the repeat gap.
+            --remaining;
+            position = 0;
+            pause = current.repeat_gap.count() * device.rate() / 1000;
+        }
+        else if (position >= wav.frame_count())
+        {
+            completions.push_back( std::move( current.on_done));
+            active = false;
+        }
+    }
+
+    streaming = streaming || written;
+    return written;
+}
+
+/// Let the io_service call device_ready() once any of the poll descriptors of the device is ready.
+void async_playback::wait_for_device()
+{
+    // the ring buffer is full, make sure that the device is playing it.
+    device.start();
+    waiting = true;
+
+    const auto current_generation = generation;
+    if (poll_fds.empty())
+    {
+        device_timer.expires_from_now( std::chrono::microseconds( device.period_size() * 1000000LL / device.rate()));
+        device_timer.async_wait( [this, current_generation]( const boost::system::error_code &error)
+                {
+                    if (!error) device_ready( current_generation);
+                });
+        return;
+    }
+
+    const auto handler = [this, current_generation]( const boost::system::error_code &error, std::size_t)
+            {
+                if (!error) device_ready( current_generation);
+            };
+    for (std::size_t index = 0; index < poll_fds.size(); ++index)
+    {
+        if (poll_fds[index].events & POLLOUT)
+        {
+            descriptors[index]->async_write_some( boost::asio::null_buffers(), handler);
+        }
+        if (poll_fds[index].events & POLLIN)
+        {
+            descriptors[index]->async_read_some( boost::asio::null_buffers(), handler);
+        }
+    }
+}
+
+/// Handle readiness of one of the poll descriptors of the device.
+/// The events are handed to alsa first, because some alsa plugins need to see them before the device
+/// reports room for more frames.
+void async_playback::device_ready( unsigned int ready_generation)
+{
+    if (ready_generation != generation) return;
+    ++generation;
+    waiting = false;
+
+    boost::system::error_code ignored;
+    for (auto &d : descriptors) d->cancel( ignored);
+
+    for (auto &fd : poll_fds) fd.revents = 0;
+    if (!poll_fds.empty() && ::poll( poll_fds.data(), poll_fds.size(), 0) > 0)
+    {
+        try
+        {
+            device.poll_revents( poll_fds);
+        }
+        catch (std::exception &)
+        {
+            // errors are dealt with by the next write.
+        }
+    }
+    pump();
+}
+
+/// Wait, without blocking, until the device has played all frames that were written to it and then
+/// complete the jobs of the stream.
+void async_playback::wait_for_drain()
+{
+    // short streams may not have filled the buffer far enough to start the device.
+    device.start();
+    draining = true;
+
+    const auto frames = static_cast<long long>( device.delay());
+    const auto rate = device.rate();
+    drain_timer.expires_from_now( std::chrono::microseconds( frames * 1000000LL / rate + 1000));
+
+    const auto current_generation = generation;
+    drain_timer.async_wait( [this, current_generation]( const boost::system::error_code &error)
+            {
+                if (error || current_generation != generation) return;
+                draining = false;
+                try
+                {
+                    if (device.delay() > 0)
+                    {
+                        wait_for_drain();
+                        return;
+                    }
+                }
+                catch (std::exception &e)
+                {
+                    std::cerr << "error while finishing playback: " << e.what() << std::endl;
+                }
+                finish();
+                pump();
+            });
+}
+
+/// End the current stream and invoke the completion handlers of all jobs that were played.
+void async_playback::finish()
+{
+    streaming = false;
+    try
+    {
+        device.prepare();
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "error while finishing playback: " << e.what() << std::endl;
+    }
+
+    for (auto &completion : completions)
+    {
+        if (completion) completion();
+    }
+    completions.clear();
+}
@@ -0,0 +1,82 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ASYNC_PLAYBACK_H_
+#define ASYNC_PLAYBACK_H_
+#include "playback_queue.h"
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/utility.hpp>
+#include <poll.h>
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/// This class plays waveforms to a pcm device without a thread of its own.
+/// The device is put in non-blocking mode and its poll descriptors are watched by the io_service, so that
+/// frames are written whenever the device has room for them, in the same thread that handles the network.
+/// Sinks without poll descriptors are checked for room every period instead.
+/// Like the playback_queue, waveforms that are queued while others are playing are transmitted as one
+/// continuous stream, separated by a gap of silence. Instead of blocking in a drain, the end of the stream is
+/// detected with a timer.
+/// All member functions must be called from the thread that runs the io_service.
+class async_playback: boost::noncopyable
+{
+public:
+    async_playback(
+            boost::asio::io_service &service, audio_sink &device, std::size_t capacity,
+            std::chrono::milliseconds gap, latency_statistics *latencies = nullptr);
+    ~async_playback();
+
+    bool push( playback_job job);
+
+private:
+    void pump();
+    bool start_next();
+    std::size_t write_current( std::size_t available);
+    void wait_for_device();
+    void device_ready( unsigned int generation);
+    void wait_for_drain();
+    void finish();
+
+    using descriptor = boost::asio::posix::stream_descriptor;
+    using completion_list = std::vector<std::function<void()>>;
+
+    boost::asio::io_service &service;
+    audio_sink              &device;
+    std::size_t             capacity;  ///< maximum number of jobs that can be waiting
+    std::chrono::milliseconds gap;       ///< silence between waveforms that are played back-to-back.
+    latency_statistics      *latencies;  ///< where to record the latencies of played jobs, may be null.
+
+    std::deque<playback_job> jobs;       ///< jobs that are waiting to be played
+    playback_job            current;     ///< job that is being written to the device
+    bool                    active = false;///< whether 'current' has frames left to write
+    std::size_t             position = 0;///< next frame of 'current' to write
+    std::size_t             pause = 0;   ///< frames of silence to write before the current job
+    unsigned int            remaining = 0;///< number of repeats of the current job that still need to start
+    bool                    streaming = false;///< whether frames were written since the device was last drained
+    completion_list         completions; ///< completion handlers of the jobs in the current stream
+    std::vector<char>       staging;     ///< buffer for frames of edge encoded waveforms
+
+    std::vector<pollfd>     poll_fds;
+    std::vector<std::unique_ptr<descriptor>> descriptors;///< the poll descriptors of the device, as seen by asio
+    boost::asio::steady_timer drain_timer;
+    boost::asio::steady_timer device_timer;///< wakes up the player for sinks without poll descriptors
+    unsigned int            generation = 0;///< increased whenever pending waits become obsolete
+    bool                    waiting = false;///< whether a wait for the device is pending
+    bool                    draining = false;///< whether a wait for the end of the stream is pending
+};
+
+#endif /* ASYNC_PLAYBACK_H_ */
@@ -0,0 +1,436 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "audio_sink.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+/// period and buffer size of the null sink for configurations that don't specify them.
+const snd_pcm_uframes_t default_period = 128;
+const snd_pcm_uframes_t default_periods = 4;
+
+/// Fill in the period and buffer size of a configuration that leaves them at 0.
+pcm_configuration with_buffering( pcm_configuration config)
+{
+    if (!config.period_size) config.period_size = default_period;
+    if (!config.buffer_size) config.buffer_size = default_periods * config.period_size;
+    return config;
+}
+
+/// Write a 16 or 32-bit value to a stream in little endian order.
+void write_le( std::ostream &output, std::uint32_t value, unsigned int bytes)
+{
+    for (unsigned int byte = 0; byte < bytes; ++byte)
+    {
+        output.put( static_cast<char>( value >> (8 * byte)));
+    }
+}
+}
+
+alsa_sink::alsa_sink( std::pair<int, int> deviceid, bool raw)
+:device{ deviceid, SND_PCM_STREAM_PLAYBACK, raw}
+{
+}
+
+bool alsa_sink::configure( const pcm_configuration &config)
+{
+    return device.configure( config);
+}
+
+bool alsa_sink::has_configuration( const pcm_configuration &config) const
+{
+    return device.has_configuration( config);
+}
+
+unsigned int alsa_sink::rate() const
+{
+    return device.rate().first;
+}
+
+snd_pcm_uframes_t alsa_sink::period_size() const
+{
+    return device.period_size().first;
+}
+
+void alsa_sink::write( const char *buffer, snd_pcm_uframes_t framecount)
+{
+    device.write( buffer, framecount);
+}
+
+void alsa_sink::write_silence( snd_pcm_uframes_t framecount)
+{
+    device.write_silence( framecount);
+}
+
+void alsa_sink::write_generated( snd_pcm_uframes_t framecount, const frame_generator &generator)
+{
+    device.write_generated( framecount, generator);
+}
+
+snd_pcm_sframes_t alsa_sink::delay()
+{
+    return device.delay();
+}
+
+void alsa_sink::start()
+{
+    device.start();
+}
+
+void alsa_sink::drain()
+{
+    device.drain();
+}
+
+void alsa_sink::drop()
+{
+    device.drop();
+}
+
+void alsa_sink::prepare()
+{
+    device.prepare();
+}
+
+void alsa_sink::set_nonblocking( bool nonblocking)
+{
+    device.set_nonblocking( nonblocking);
+}
+
+std::vector<pollfd> alsa_sink::poll_descriptors() const
+{
+    return device.poll_descriptors();
+}
+
+unsigned short alsa_sink::poll_revents( std::vector<pollfd> &descriptors) const
+{
+    return device.poll_revents( descriptors);
+}
+
+snd_pcm_uframes_t alsa_sink::available()
+{
+    return device.available();
+}
+
+snd_pcm_uframes_t alsa_sink::try_write( const char *buffer, snd_pcm_uframes_t framecount)
+{
+    return device.try_write( buffer, framecount);
+}
+
+snd_pcm_uframes_t alsa_sink::try_write_silence( snd_pcm_uframes_t framecount)
+{
+    return device.try_write_silence( framecount);
+}
+
+pcm_statistics alsa_sink::statistics() const
+{
+    return device.statistics();
+}
+
+null_sink::null_sink( bool real_time)
+:real_time( real_time)
+{
+}
+
+/// Set up the sink for a sample format. Period and buffer size that the configuration leaves at 0
+/// default to 128 and 512 frames.
+/// Like a pcm device, a sink that is reconfigured drops the frames that it hadn't played yet.
+bool null_sink::configure( const pcm_configuration &requested)
+{
+    const auto config = with_buffering( requested);
+    if (configured && config == current)
+    {
+        ++reuse_count;
+        return false;
+    }
+
+    if (negotiated.insert( config).second) ++negotiation_count;
+    ++reconfiguration_count;
+    current = config;
+    configured = true;
+    bytes_per_frame = snd_pcm_format_physical_width( config.format) / 8 * config.channels;
+    staging.resize( config.period_size * bytes_per_frame);
+    prepare();
+    return true;
+}
+
+bool null_sink::has_configuration( const pcm_configuration &config) const
+{
+    return configured && with_buffering( config) == current;
+}
+
+unsigned int null_sink::rate() const
+{
+    return current.rate;
+}
+
+snd_pcm_uframes_t null_sink::period_size() const
+{
+    return current.period_size;
+}
+
+/// Write all frames to the sink. In real time mode, this blocks while the buffer of the sink is full.
+void null_sink::write( const char *buffer, snd_pcm_uframes_t framecount)
+{
+    while (framecount)
+    {
+        const auto accepted = accept( buffer, framecount);
+        if (!accepted)
+        {
+            // sleep until the sink has played enough frames to make room for a period.
+            const auto needed = std::min( framecount, current.period_size) - available();
+            std::this_thread::sleep_for( std::chrono::microseconds( needed * 1000000 / current.rate + 1));
+            continue;
+        }
+        if (buffer) buffer += accepted * bytes_per_frame;
+        framecount -= accepted;
+    }
+}
+
+void null_sink::write_silence( snd_pcm_uframes_t framecount)
+{
+    write( nullptr, framecount);
+}
+
+void null_sink::write_generated( snd_pcm_uframes_t framecount, const frame_generator &generator)
+{
+    for (snd_pcm_uframes_t offset = 0; offset < framecount; offset += current.period_size)
+    {
+        const auto count = std::min( current.period_size, framecount - offset);
+        generator( staging.data(), offset, count);
+        write( staging.data(), count);
+    }
+}
+
+/// returns the number of frames that have been written, but not yet played.
+/// A sink that is not in real time mode plays every frame the moment it is written.
+snd_pcm_sframes_t null_sink::delay()
+{
+    return written - frames_played();
+}
+
+/// The sink starts playing as soon as the first frames are written.
+void null_sink::start()
+{
+}
+
+/// Wait until all frames that were written have been played and stop playing.
+void null_sink::drain()
+{
+    if (real_time && running && current.rate)
+    {
+        std::this_thread::sleep_for( std::chrono::microseconds( delay() * 1000000 / current.rate));
+    }
+    prepare();
+}
+
+/// Stop playing immediately. Like prepare(), this drops the frames that weren't played yet.
+void null_sink::drop()
+{
+    prepare();
+}
+
+/// Stop playing, dropping any frames that weren't played yet.
+void null_sink::prepare()
+{
+    running = false;
+    written = 0;
+}
+
+/// Writes through try_write() never block, so there is nothing to switch.
+void null_sink::set_nonblocking( bool)
+{
+}
+
+/// The sink isn't backed by a file descriptor.
+std::vector<pollfd> null_sink::poll_descriptors() const
+{
+    return {};
+}
+
+unsigned short null_sink::poll_revents( std::vector<pollfd> &) const
+{
+    return POLLOUT;
+}
+
+/// returns the number of frames that can be written without blocking.
+snd_pcm_uframes_t null_sink::available()
+{
+    return buffer_size() - delay();
+}
+
+snd_pcm_uframes_t null_sink::try_write( const char *buffer, snd_pcm_uframes_t framecount)
+{
+    return accept( buffer, framecount);
+}
+
+snd_pcm_uframes_t null_sink::try_write_silence( snd_pcm_uframes_t framecount)
+{
+    return accept( nullptr, std::min( framecount, current.period_size));
+}
+
+pcm_statistics null_sink::statistics() const
+{
+    return { reconfiguration_count, negotiation_count, reuse_count, underrun_count};
+}
+
+/// The null sink discards all frames.
+void null_sink::consume( const char *, snd_pcm_uframes_t)
+{
+}
+
+snd_pcm_uframes_t null_sink::buffer_size() const
+{
+    return current.buffer_size;
+}
+
+/// returns the number of frames of the current stream that have been played.
+std::uint64_t null_sink::frames_played() const
+{
+    if (!real_time) return written;
+    if (!running) return 0;
+    return std::min( written, elapsed_frames());
+}
+
+/// returns the number of frames that could have been played since the current stream started.
+std::uint64_t null_sink::elapsed_frames() const
+{
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>( clock_type::now() - started);
+    return static_cast<std::uint64_t>( elapsed.count()) * current.rate / 1000000;
+}
+
+/// Take as many of the given frames as fit in the buffer of the sink.
+/// If the sink played all frames before these arrived, it suffered an underrun and a new stream is started.
+snd_pcm_uframes_t null_sink::accept( const char *buffer, snd_pcm_uframes_t framecount)
+{
+    if (!configured) throw std::runtime_error( "sink is not configured");
+
+    if (real_time && running && elapsed_frames() > written)
+    {
+        ++underrun_count;
+        prepare();
+    }
+
+    const auto count = std::min( framecount, available());
+    if (!count) return 0;
+    if (!running)
+    {
+        running = true;
+        started = clock_type::now();
+    }
+    consume( buffer, count);
+    written += count;
+    total_frames += count;
+    return count;
+}
+
+wav_file_sink::wav_file_sink( const std::string &filename, bool real_time)
+:null_sink( real_time), filename( filename)
+{
+}
+
+wav_file_sink::~wav_file_sink()
+{
+    close_file();
+}
+
+/// Set up the sink for a sample format. A new file is started if frames were written in another format.
+bool wav_file_sink::configure( const pcm_configuration &config)
+{
+    const bool reconfigured = null_sink::configure( config);
+    const auto &current = configuration();
+    if (reconfigured && file.is_open() && data_size
+            && (current.format != file_format.format || current.rate != file_format.rate
+                    || current.channels != file_format.channels))
+    {
+        close_file();
+        ++sequence;
+    }
+    if (!file.is_open())
+    {
+        file_format = current;
+        open_file();
+    }
+    if (reconfigured)
+    {
+        silence.resize( current.period_size * frame_size());
+        snd_pcm_format_set_silence( current.format, silence.data(), current.period_size * current.channels);
+    }
+    return reconfigured;
+}
+
+/// Append frames to the file, silence is written as actual samples.
+void wav_file_sink::consume( const char *frames, snd_pcm_uframes_t framecount)
+{
+    const std::size_t size = framecount * frame_size();
+    if (frames)
+    {
+        file.write( frames, size);
+    }
+    else
+    {
+        for (std::size_t offset = 0; offset < size; offset += silence.size())
+        {
+            file.write( silence.data(), std::min( silence.size(), size - offset));
+        }
+    }
+    data_size += size;
+}
+
+/// Open the next file and write a header, of which the sizes are filled in by close_file().
+void wav_file_sink::open_file()
+{
+    std::string name = filename;
+    if (sequence)
+    {
+        const auto dot = name.rfind( '.');
+        const auto suffix = "-" + std::to_string( sequence);
+        if (dot == std::string::npos || name.find( '/', dot) != std::string::npos)
+        {
+            name += suffix;
+        }
+        else
+        {
+            name.insert( dot, suffix);
+        }
+    }
+
+    file.open( name, std::ios::binary | std::ios::trunc);
+    if (!file) throw std::runtime_error( "could not open " + name + " for writing");
+
+    const unsigned int bits = snd_pcm_format_physical_width( file_format.format);
+    const unsigned int block_align = bits / 8 * file_format.channels;
+    file.write( "RIFF", 4);
+    write_le( file, 0, 4);
+    file.write( "WAVEfmt ", 8);
+    write_le( file, 16, 4);
+    write_le( file, 1, 2); // uncompressed samples
+    write_le( file, file_format.channels, 2);
+    write_le( file, file_format.rate, 4);
+    write_le( file, file_format.rate * block_align, 4);
+    write_le( file, block_align, 2);
+    write_le( file, bits, 2);
+    file.write( "data", 4);
+    write_le( file, 0, 4);
+    data_size = 0;
+}
+
+/// Fill in the sizes in the header of the current file and close it.
+void wav_file_sink::close_file()
+{
+    if (!file.is_open()) return;
+    file.seekp( 4);
+    write_le( file, static_cast<std::uint32_t>( 36 + data_size), 4);
+    file.seekp( 40);
+    write_le( file, static_cast<std::uint32_t>( data_size), 4);
+    file.close();
+}
@@ -0,0 +1,191 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef AUDIO_SINK_H_
+#define AUDIO_SINK_H_
+#include "alsa_wrapper.hpp"
+
+#include <boost/utility.hpp>
+#include <poll.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+/// Destination of the frames that the players produce.
+/// The interface follows the pcm device that it abstracts: a sink is configured for a sample format, frames
+/// are written to it, either blocking or non-blocking, and delay() tells how many of the written frames are
+/// still waiting to be played. Sinks that are not backed by a device have no poll descriptors, players
+/// that don't block poll those sinks with a timer instead.
+class audio_sink: boost::noncopyable
+{
+public:
+    /// called as generator( destination, offset, count) to produce 'count' frames, starting at frame 'offset'.
+    using frame_generator = std::function<void( char *, snd_pcm_uframes_t, snd_pcm_uframes_t)>;
+
+    virtual ~audio_sink() = default;
+
+    virtual bool configure( const pcm_configuration &config) = 0;
+    virtual bool has_configuration( const pcm_configuration &config) const = 0;
+    virtual unsigned int rate() const = 0;
+    virtual snd_pcm_uframes_t period_size() const = 0;
+
+    virtual void write( const char *buffer, snd_pcm_uframes_t framecount) = 0;
+    virtual void write_silence( snd_pcm_uframes_t framecount) = 0;
+    virtual void write_generated( snd_pcm_uframes_t framecount, const frame_generator &generator) = 0;
+    virtual snd_pcm_sframes_t delay() = 0;
+    virtual void start() = 0;
+    virtual void drain() = 0;
+    virtual void drop() = 0;
+    virtual void prepare() = 0;
+
+    virtual void set_nonblocking( bool nonblocking) = 0;
+    virtual std::vector<pollfd> poll_descriptors() const = 0;
+    virtual unsigned short poll_revents( std::vector<pollfd> &descriptors) const = 0;
+    virtual snd_pcm_uframes_t available() = 0;
+    virtual snd_pcm_uframes_t try_write( const char *buffer, snd_pcm_uframes_t framecount) = 0;
+    virtual snd_pcm_uframes_t try_write_silence( snd_pcm_uframes_t framecount) = 0;
+
+    virtual pcm_statistics statistics() const = 0;
+};
+
+/// Sink that plays to an alsa pcm device.
+class alsa_sink: public audio_sink
+{
+public:
+    alsa_sink( std::pair<int, int> deviceid, bool raw = false);
+
+    /// the pcm device itself, for settings that only apply to alsa devices.
+    opened_pcm_device &pcm() { return device;}
+
+    bool configure( const pcm_configuration &config) override;
+    bool has_configuration( const pcm_configuration &config) const override;
+    unsigned int rate() const override;
+    snd_pcm_uframes_t period_size() const override;
+
+    void write( const char *buffer, snd_pcm_uframes_t framecount) override;
+    void write_silence( snd_pcm_uframes_t framecount) override;
+    void write_generated( snd_pcm_uframes_t framecount, const frame_generator &generator) override;
+    snd_pcm_sframes_t delay() override;
+    void start() override;
+    void drain() override;
+    void drop() override;
+    void prepare() override;
+
+    void set_nonblocking( bool nonblocking) override;
+    std::vector<pollfd> poll_descriptors() const override;
+    unsigned short poll_revents( std::vector<pollfd> &descriptors) const override;
+    snd_pcm_uframes_t available() override;
+    snd_pcm_uframes_t try_write( const char *buffer, snd_pcm_uframes_t framecount) override;
+    snd_pcm_uframes_t try_write_silence( snd_pcm_uframes_t framecount) override;
+
+    pcm_statistics statistics() const override;
+
+private:
+    opened_pcm_device device;
+};
+
+/// Sink that discards all frames.
+/// In real time mode, the sink behaves like a sound card with a ring buffer: it consumes frames at the sample
+/// rate of its configuration, writes block while the buffer is full and underruns are counted when the
+/// buffer runs dry. Otherwise, every frame is consumed the moment it is written.
+/// This sink can be used to run the service, or benchmarks, on machines without a sound card.
+class null_sink: public audio_sink
+{
+public:
+    explicit null_sink( bool real_time);
+
+    /// returns the number of frames that were written to this sink so far, silence included.
+    std::uint64_t frames_consumed() const { return total_frames;}
+
+    bool configure( const pcm_configuration &config) override;
+    bool has_configuration( const pcm_configuration &config) const override;
+    unsigned int rate() const override;
+    snd_pcm_uframes_t period_size() const override;
+
+    void write( const char *buffer, snd_pcm_uframes_t framecount) override;
+    void write_silence( snd_pcm_uframes_t framecount) override;
+    void write_generated( snd_pcm_uframes_t framecount, const frame_generator &generator) override;
+    snd_pcm_sframes_t delay() override;
+    void start() override;
+    void drain() override;
+    void drop() override;
+    void prepare() override;
+
+    void set_nonblocking( bool nonblocking) override;
+    std::vector<pollfd> poll_descriptors() const override;
+    unsigned short poll_revents( std::vector<pollfd> &descriptors) const override;
+    snd_pcm_uframes_t available() override;
+    snd_pcm_uframes_t try_write( const char *buffer, snd_pcm_uframes_t framecount) override;
+    snd_pcm_uframes_t try_write_silence( snd_pcm_uframes_t framecount) override;
+
+    pcm_statistics statistics() const override;
+
+protected:
+    /// called with every block of frames that the sink accepts. Silence is passed as a null pointer.
+    virtual void consume( const char *frames, snd_pcm_uframes_t framecount);
+
+    const pcm_configuration &configuration() const { return current;}
+    unsigned int frame_size() const { return bytes_per_frame;}
+
+private:
+    using clock_type = std::chrono::steady_clock;
+
+    snd_pcm_uframes_t buffer_size() const;
+    std::uint64_t frames_played() const;
+    std::uint64_t elapsed_frames() const;
+    snd_pcm_uframes_t accept( const char *buffer, snd_pcm_uframes_t framecount);
+
+    bool                real_time;
+    bool                configured = false;
+    pcm_configuration   current{ SND_PCM_FORMAT_UNKNOWN, 0, 0, 0, 0};
+    std::set<pcm_configuration> negotiated; ///< all configurations that were used so far
+    unsigned int        bytes_per_frame = 0;
+    std::vector<char>   staging;        ///< buffer for generated frames
+    bool                running = false;
+    clock_type::time_point started;     ///< moment that the first frame of the current stream was played
+    std::uint64_t       written = 0;    ///< frames written since the stream started
+    std::atomic<std::uint64_t> total_frames{0};
+    std::atomic<unsigned long> reconfiguration_count{0};
+    std::atomic<unsigned long> negotiation_count{0};
+    std::atomic<unsigned long> reuse_count{0};
+    std::atomic<unsigned long> underrun_count{0};
+};
+
+/// Sink that writes all frames that are played to a wav file, in real time or as fast as possible.
+/// If the sink is reconfigured for another sample format after frames were written, the file is closed and
+/// a new file is started, with a sequence number added to its name.
+class wav_file_sink: public null_sink
+{
+public:
+    wav_file_sink( const std::string &filename, bool real_time);
+    ~wav_file_sink();
+
+    bool configure( const pcm_configuration &config) override;
+
+protected:
+    void consume( const char *frames, snd_pcm_uframes_t framecount) override;
+
+private:
+    void open_file();
+    void close_file();
+
+    std::string         filename;
+    unsigned int        sequence = 0;   ///< number of files that were started before the current one
+    std::ofstream       file;
+    pcm_configuration   file_format{ SND_PCM_FORMAT_UNKNOWN, 0, 0, 0, 0};
+    std::uint64_t       data_size = 0;
+    std::vector<char>   silence;
+};
+
+#endif /* AUDIO_SINK_H_ */
@@ -0,0 +1,35 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( MAPPED_WAV_FILE_HPP)
+#define MAPPED_WAV_FILE_HPP
+#include <string>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "wav_file.hpp"
+
+/// A wav file that is mapped into memory.
+/// The file is parsed on construction and its samples can be read directly through get().data.samples
+/// for as long as this object exists, without copying them first.
+class mapped_wav_file
+{
+public:
+    explicit mapped_wav_file( const std::string &filename);
+
+    const wav_file &get() const
+    {
+        return wav;
+    }
+
+private:
+    boost::interprocess::file_mapping  mapping;
+    boost::interprocess::mapped_region region;
+    wav_file                           wav;
+};
+
+#endif //MAPPED_WAV_FILE_HPP
@@ -11,6 +11,7 @@
 #if !defined(WAV_FILE_HPP)
 #define WAV_FILE_HPP
 #include <cstdint>
+#include <cstddef>
 struct riff_fmt
 {
     uint16_t compression;
@@ -23,13 +24,14 @@ struct riff_fmt
 
 struct riff_data
 {
-    std::size_t pos; ///<position in file of samples
-    uint32_t    size;///<size of sample data.
+    std::size_t     pos;    ///<position in file of samples
+    uint32_t        size;   ///<size of sample data.
+    const uint8_t   *samples;///<the sample data itself if the file was parsed from memory, nullptr otherwise.
 };
 
 struct wav_file
 {
     riff_fmt  fmt; ///< information about the format of the sound data
-    riff_data data;///< the sound data itself, in the form of offsets into the original file.
+    riff_data data;///< the sound data itself, in the form of offsets into the original file or a pointer to memory.
 };
 #endif //WAV_FILE_HPP
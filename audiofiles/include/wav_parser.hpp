@@ -9,10 +9,16 @@
 #if !defined( WAV_PARSER_HPP)
 #define WAV_PARSER_HPP
 #include <iosfwd>
+#include <cstddef>
+#include <cstdint>
 #include "wav_file.hpp"
 
 /// parse the midi file represented by stream 'stream' and return the information of that file in output parameter 'result'.
 /// This function returns true iff the file could be completely parsed as a midi file.
 bool parse_wavfile( std::istream &stream, wav_file &result);
 
+/// parse a wav file of 'size' bytes that is held in memory at 'data'.
+/// On success, result.data.samples points into the given memory.
+bool parse_wavfile( const uint8_t *data, std::size_t size, wav_file &result);
+
 #endif //WAV_PARSER_HPP
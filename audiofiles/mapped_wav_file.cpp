@@ -0,0 +1,25 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "include/mapped_wav_file.hpp"
+#include "include/wav_parser.hpp"
+#include <stdexcept>
+
+namespace bi = boost::interprocess;
+
+/// Map the file with the given name into memory and parse it.
+/// This constructor throws if the file cannot be mapped or is not a valid wav file.
+mapped_wav_file::mapped_wav_file( const std::string &filename)
+:mapping( filename.c_str(), bi::read_only), region( mapping, bi::read_only), wav()
+{
+    if (!parse_wavfile( static_cast<const uint8_t *>( region.get_address()), region.get_size(), wav)
+            || !wav.data.samples)
+    {
+        throw std::runtime_error( "parsing file " + filename + " failed");
+    }
+}
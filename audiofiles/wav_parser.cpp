@@ -11,6 +11,7 @@
 #include <string>
 #include <stdexcept>
 #include <deque>
+#include <algorithm>
 
 /// simple wav-file reader class. objects of this class can be used to read a wav file and parse it for information about the
 /// sample format and the location in the file of the sample data.
@@ -40,8 +41,8 @@ public:
             // do nothing
         }
 
-        return in;
-}
+        return static_cast<bool>( in);
+    }
 
 private:
     /// Expect a 4-character sequence in the file.
@@ -87,20 +88,20 @@ private:
         // add 1 if chunksize is odd.
         chunksize += chunksize%2;
         chunksize -= 16;
-        while (chunksize) next();
+        while (chunksize--) next();
 
-        return expect(in, "format error while reading format chunk");
+        return expect( static_cast<bool>( in), "format error while reading format chunk");
     }
 
     /// Tentatively read a data chunk. Return false if no data chunk was found.
     bool data()
     {
         if (!expect("data", false)) return false;
-        uint32_t chunksize = 0;
         read( result.data.size);
         result.data.pos = in.tellg();
+        result.data.samples = nullptr;
         in.seekg( result.data.size + result.data.size%2, std::ios_base::cur);
-        return in;
+        return static_cast<bool>( in);
     }
 
     /// read a 4-byte little endian integer
@@ -111,7 +112,7 @@ private:
         value |= next() << 8;
         value |= next() << 16;
         value |= next() << 24;
-        return in;
+        return static_cast<bool>( in);
     }
 
     /// read a 2-byte little endian integer
@@ -119,7 +120,7 @@ private:
     {
         value = next();
         value |= next() << 8;
-        return in;
+        return static_cast<bool>( in);
     }
 
     /// get the next character, either from the buffer or directly from the file if there are no characters to read from the buffer.
@@ -178,6 +179,126 @@ private:
     deque::iterator buffer_pos = buffer.begin();
 };
 
+/// wav-file reader for files that are held in memory.
+/// Contrary to the stream based wav_reader, this class can look ahead freely and read multi-byte values in one go.
+class wav_memory_reader
+{
+public:
+    using wav_file_exception = wav_reader::wav_file_exception;
+
+    wav_memory_reader( const uint8_t *data, std::size_t size, wav_file &result)
+    :begin( data), current( data), end( data + size), result( result) {}
+
+    bool riff()
+    {
+        expect( "RIFF");
+        load32(); // file size
+        expect( "WAVE");
+
+        while (current != end && expect( fmt() || data(), "expected either a fmt- or a data chunk"))
+        {
+            // do nothing
+        }
+
+        return true;
+    }
+
+private:
+    /// Expect a 4-character sequence at the current position and move past it.
+    bool expect( const char (&keyword)[5], bool throw_if_fail = true)
+    {
+        const bool found = available( 4) && std::equal( current, current + 4, keyword);
+        if (found)
+        {
+            current += 4;
+        }
+        else if (throw_if_fail)
+        {
+            throw wav_file_exception( "couldn't find sequence \"" + std::string(keyword, 4) + "\"");
+        }
+        return found;
+    }
+
+    /// Read a format chunk, if there is one at the current position.
+    bool fmt()
+    {
+        if (!expect("fmt ", false)) return false;
+
+        uint32_t chunksize = load32();
+        expect( chunksize >= 16, "fmt chunk is unexpectedly small");
+        expect( available( chunksize), "format error while reading format chunk");
+
+        result.fmt.compression      = load16( current);
+        result.fmt.channels         = load16( current + 2);
+        result.fmt.samplerate       = load32( current + 4);
+        result.fmt.bytes_per_second = load32( current + 8);
+        result.fmt.block_align      = load16( current + 12);
+        result.fmt.bits_per_sample  = load16( current + 14);
+
+        // add 1 if chunksize is odd.
+        skip( chunksize + chunksize%2);
+        return true;
+    }
+
+    /// Read a data chunk, if there is one at the current position.
+    bool data()
+    {
+        if (!expect("data", false)) return false;
+
+        result.data.size = load32();
+        expect( available( result.data.size), "data chunk extends beyond the end of the file");
+        result.data.pos = current - begin;
+        result.data.samples = current;
+        skip( result.data.size + result.data.size%2);
+        return true;
+    }
+
+    /// read a 4-byte little endian integer and move past it.
+    uint32_t load32()
+    {
+        expect( available( 4), "unexpected end of file");
+        const auto value = load32( current);
+        current += 4;
+        return value;
+    }
+
+    /// load a 4-byte little endian integer.
+    /// Compilers recognize this pattern and turn it into a single load on little endian machines.
+    static uint32_t load32( const uint8_t *bytes)
+    {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (uint32_t(bytes[3]) << 24);
+    }
+
+    /// load a 2-byte little endian integer.
+    static uint16_t load16( const uint8_t *bytes)
+    {
+        return bytes[0] | (bytes[1] << 8);
+    }
+
+    bool available( std::size_t count) const
+    {
+        return count <= static_cast<std::size_t>( end - current);
+    }
+
+    /// move ahead, but never past the end. The padding byte of a chunk at the end of a file is often missing.
+    void skip( std::size_t count)
+    {
+        current += std::min<std::size_t>( count, end - current);
+    }
+
+    /// throw an exception if the input value is false, return the input value otherwise
+    static bool expect( bool input, const std::string &expected_as_string)
+    {
+        if (!input) throw wav_file_exception( expected_as_string);
+        return input;
+    }
+
+    const uint8_t *begin;
+    const uint8_t *current;
+    const uint8_t *end;
+    wav_file      &result;
+};
+
 /// parse the wav file that the istream 'in' refers to and return the result in a wav_file structure
 /// Note that on some platforms the input file must have been opened as binary.
 bool parse_wavfile( std::istream &in, wav_file &result)
@@ -187,3 +308,12 @@ bool parse_wavfile( std::istream &in, wav_file &result)
     wav_reader reader(in, result);
     return reader.riff();
 }
+
+/// parse the wav file that is held in memory at 'data' and return the result in a wav_file structure.
+/// Instead of offsets into the file, the resulting structure contains a pointer to the sample data, which
+/// remains valid for as long as the given memory does.
+bool parse_wavfile( const uint8_t *data, std::size_t size, wav_file &result)
+{
+    wav_memory_reader reader( data, size, result);
+    return reader.riff();
+}
@@ -0,0 +1,706 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/// Microbenchmarks for the parts of cheapl that every command goes through: parsing datagrams, dispatching
+/// and serializing messages, parsing wav files and playing waveforms. Playback goes to a null sink, so no
+/// sound card is needed.
+/// Before measuring, the benchmark checks that parse_datagram() produces the same messages as the line
+/// based datagram_parser for a large number of generated datagrams, that x10.basic bodies read from
+/// message views agree with the fields of the messages and that edge encoded RF codes play exactly like their
+/// samples. The compression ratio of those codes is reported along with the benchmarks.
+/// The results are written to standard output as a JSON document, so that they can be compared across
+/// releases. The program fails if any of the checks failed.
+///
+/// usage: cheapl_bench [--min-time=<ms>] [--filter=<text>]
+
+#include "datagramparser.h"
+#include "xpl_application_service.h"
+#include "schema_table.h"
+#include "x10_schema.h"
+#include "audio_sink.h"
+#include "playback_queue.h"
+#include "waveform_cache.h"
+#include "rf_synthesizer.h"
+#include "sample_conversion.h"
+#include "audiofiles/include/wav_parser.hpp"
+
+#include <boost/tokenizer.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace xpl
+{
+/// Calls the private functions of the application service that every message goes through.
+struct bench_access
+{
+    static void handle_message( application_service &service, const message &m)
+    {
+        service.handle_message( m);
+    }
+
+    static void send_heartbeat_message( application_service &service)
+    {
+        service.send_heartbeat_message();
+    }
+};
+}
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+/// The outcome of a single benchmark.
+struct bench_result
+{
+    std::string     name;
+    std::uint64_t   iterations;
+    double          ns_per_op;
+    std::size_t     bytes_per_op;   ///< bytes that a single operation processes, or 0 if it doesn't process all of its input
+    std::string     error;          ///< why the benchmark could not run, empty on success
+};
+
+/// The outcome of a check of the correctness of an optimized function.
+struct check_result
+{
+    std::string     name;
+    std::uint64_t   cases;
+    std::uint64_t   failures;
+    std::string     example;        ///< input of the first failure, if any
+};
+
+/// A quantity that isn't a time, like a compression ratio.
+struct measurement
+{
+    std::string     name;
+    double          value;
+};
+
+/// Runs benchmarks and collects their results.
+class bench_runner
+{
+public:
+    bench_runner( std::chrono::milliseconds min_time, const std::string &filter)
+    :min_time( min_time), filter( filter)
+    {}
+
+    /// Call 'operation' repeatedly, doubling the number of calls until they take at least the minimum time.
+    /// 'bytes' is the size of the input that a single call processes.
+    void run( const std::string &name, std::size_t bytes, const std::function<void()> &operation)
+    {
+        if (name.find( filter) == std::string::npos) return;
+
+        bench_result result{ name, 0, 0, bytes, {}};
+        try
+        {
+            operation(); // warm up caches and lazily created state.
+            for (std::uint64_t iterations = 1;; iterations *= 2)
+            {
+                const auto start = clock_type::now();
+                for (std::uint64_t i = 0; i < iterations; ++i) operation();
+                const auto elapsed = clock_type::now() - start;
+                if (elapsed >= min_time || iterations >= (1ull << 40))
+                {
+                    result.iterations = iterations;
+                    result.ns_per_op = std::chrono::duration<double, std::nano>( elapsed).count() / iterations;
+                    break;
+                }
+            }
+        }
+        catch (std::exception &e)
+        {
+            result.error = e.what();
+        }
+        results.push_back( result);
+    }
+
+    void add_check( const check_result &result)
+    {
+        checks.push_back( result);
+    }
+
+    void add_measurement( const measurement &result)
+    {
+        measurements.push_back( result);
+    }
+
+    /// returns whether all checks passed.
+    bool checks_passed() const
+    {
+        for (const auto &check : checks)
+        {
+            if (check.failures) return false;
+        }
+        return true;
+    }
+
+    void write_json( std::ostream &output) const
+    {
+        output << "{\n  \"checks\": [";
+        const char *separator = "\n";
+        for (const auto &check : checks)
+        {
+            output << separator << "    {\"name\": \"" << check.name << "\", \"cases\": " << check.cases
+                    << ", \"failures\": " << check.failures;
+            if (check.failures) output << ", \"example\": \"" << escaped( check.example) << '"';
+            output << '}';
+            separator = ",\n";
+        }
+
+        output << "\n  ],\n  \"measurements\": [";
+        separator = "\n";
+        for (const auto &result : measurements)
+        {
+            output << separator << "    {\"name\": \"" << result.name << "\", \"value\": "
+                    << std::fixed << std::setprecision( 1) << result.value << '}';
+            separator = ",\n";
+        }
+
+        output << "\n  ],\n  \"benchmarks\": [";
+        separator = "\n";
+        for (const auto &result : results)
+        {
+            output << separator << "    {\"name\": \"" << result.name << '"';
+            if (!result.error.empty())
+            {
+                output << ", \"error\": \"" << escaped( result.error) << "\"}";
+            }
+            else
+            {
+                output << ", \"iterations\": " << result.iterations
+                        << ", \"ns_per_op\": " << std::fixed << std::setprecision( 1) << result.ns_per_op;
+                if (result.bytes_per_op)
+                {
+                    output << ", \"bytes_per_op\": " << result.bytes_per_op
+                            << ", \"mb_per_second\": " << std::setprecision( 1)
+                            << result.bytes_per_op * 1e3 / result.ns_per_op;
+                }
+                output << '}';
+            }
+            separator = ",\n";
+        }
+        output << "\n  ]\n}\n";
+    }
+
+private:
+    static std::string escaped( const std::string &text)
+    {
+        static const char hex[] = "0123456789abcdef";
+        std::string result;
+        for (auto c : text)
+        {
+            const auto byte = static_cast<unsigned char>( c);
+            if (c == '"' || c == '\\') result += '\\';
+            if (byte >= 0x20 && byte < 0x80) result += c;
+            else result += std::string{ "\\u00"} + hex[byte >> 4] + hex[byte & 0xf];
+        }
+        return result;
+    }
+
+    std::chrono::milliseconds   min_time;
+    std::string                 filter;
+    std::vector<bench_result>   results;
+    std::vector<check_result>   checks;
+    std::vector<measurement>    measurements;
+};
+
+/// Keeps the compiler from optimizing away the results of benchmarked operations.
+volatile std::size_t sink_value;
+
+/// An x10.basic command, as a hub would forward it.
+const std::string command_datagram =
+        "xpl-cmnd\n"
+        "{\n"
+        "hop=1\n"
+        "source=domogik-rest.server\n"
+        "target=*\n"
+        "}\n"
+        "x10.basic\n"
+        "{\n"
+        "command=on\n"
+        "device=a1\n"
+        "}\n";
+
+/// A heartbeat of another application, as every listener on the network receives it.
+const std::string heartbeat_datagram =
+        "xpl-stat\n"
+        "{\n"
+        "hop=1\n"
+        "source=vendor-device.instance\n"
+        "target=*\n"
+        "}\n"
+        "hbeat.app\n"
+        "{\n"
+        "interval=5\n"
+        "port=50000\n"
+        "remote-ip=192.168.1.10\n"
+        "version=1.0\n"
+        "}\n";
+
+/// Feed the lines of a datagram to a datagram_parser, the way that the application service used to.
+xpl::datagram_parser feed_lines( const std::string &datagram)
+{
+    using separator_t = boost::char_separator<char>;
+    using tokenizer_t = boost::tokenizer<separator_t, std::string::const_iterator>;
+    tokenizer_t tokenizer( datagram.begin(), datagram.end(), separator_t( "\n"));
+    xpl::datagram_parser parser;
+    for (const auto &line : tokenizer)
+    {
+        parser.feed_line( line);
+    }
+    return parser;
+}
+
+/// Parse a datagram with the datagram_parser.
+xpl::message parse_lines( const std::string &datagram)
+{
+    const auto parser = feed_lines( datagram);
+    if (!parser.is_ready()) throw std::runtime_error( "could not parse datagram");
+    return parser.get_message();
+}
+
+bool same_message( const xpl::message &left, const xpl::message &right)
+{
+    return left.message_type == right.message_type && left.message_schema == right.message_schema
+            && left.headers == right.headers && left.body == right.body;
+}
+
+/// Check that parse_datagram() agrees with the datagram_parser on datagrams that are put together from
+/// random lines, including lines with odd white space, lines that aren't name=value pairs and braces
+/// in unexpected places.
+check_result check_datagram_parser()
+{
+    static const std::vector<std::string> lines = {
+            "xpl-cmnd", "xpl-stat", "{", "}", " { ", "\t}\r", "x10.basic", "hbeat.app", "hop=1", "target=*",
+            "source=vendor-device.instance", "command=on", "device=a1", " name = value ", "name\t=\tvalue",
+            "name value=x", "=value", "name=", "name==value", "name=a=b", "na me=x", "\r", " ", "\t\v\f",
+            "}{", "no pairs here", "key= spaced value  ", "x\x01=y", "\xff=\xfe", "a\t b=c"};
+    std::mt19937 random{ 20141109};
+    std::uniform_int_distribution<std::size_t> pick_line( 0, lines.size() - 1);
+    std::uniform_int_distribution<int> pick_count( 0, 14);
+    std::uniform_int_distribution<int> pick_separator( 0, 5);
+
+    check_result result{ "parse_datagram matches datagram_parser", 0, 0, {}};
+    for (int round = 0; round < 100000; ++round)
+    {
+        std::string datagram;
+        const int count = pick_count( random);
+        for (int line = 0; line < count; ++line)
+        {
+            const int separator = pick_separator( random);
+            datagram += separator == 0 ? "\n\n" : separator == 1 ? "\r\n" : "\n";
+            datagram += lines[pick_line( random)];
+        }
+        // most datagrams should hold a complete message, so that the message contents get compared too.
+        if (round % 2) datagram = command_datagram.substr( 0, round % command_datagram.size()) + datagram;
+        else datagram = "xpl-cmnd\n{\n" + datagram + "\n}\nx10.basic\n{\n" + datagram + "\n}\n";
+
+        const auto parser = feed_lines( datagram);
+        xpl::message_view view;
+        const bool ready = xpl::parse_datagram( datagram.data(), datagram.size(), view);
+        if (view.overflow) continue;
+
+        ++result.cases;
+        if (ready != parser.is_ready() || (ready && !same_message( view.to_message(), parser.get_message())))
+        {
+            if (!result.failures++) result.example = datagram;
+        }
+    }
+    return result;
+}
+
+/// Read an x10.basic body from the fields of a message with plain map lookups, as a reference for
+/// read_x10_basic().
+bool reference_x10_basic( const xpl::message::map &body, xpl::x10_basic &result)
+{
+    const auto field = [&body]( const std::string &name)
+            {
+                const auto found = body.find( name);
+                return found == body.end() ? boost::string_view{} : boost::string_view{ found->second};
+            };
+    result = xpl::x10_basic{};
+    result.command_text = field( "command");
+    if (body.count( "command")) result.command = xpl::find_x10_command( result.command_text);
+    result.device = field( "device");
+    result.house = field( "house");
+    result.level = field( "level");
+    result.repeat = field( "repeat");
+    return body.count( "command") && body.count( "device");
+}
+
+bool same_x10_basic( const xpl::x10_basic &left, const xpl::x10_basic &right)
+{
+    return left.command == right.command && left.command_text == right.command_text && left.device == right.device
+            && left.house == right.house && left.level == right.level && left.repeat == right.repeat;
+}
+
+/// Check that reading an x10.basic body from a message_view gives the same result as looking its fields up
+/// in the message that the view turns into, for bodies with missing, empty, unknown and repeated fields.
+check_result check_x10_basic()
+{
+    static const std::vector<std::string> lines = {
+            "command=on", "command=off", "command=dim", "command=ON", "command=", "command=bogus", "device=a1",
+            "device=b12", "device=", "house=c", "level=50", "repeat=3", "repeat=x", "data1=0", "name=value"};
+    std::mt19937 random{ 20141109};
+    std::uniform_int_distribution<std::size_t> pick_line( 0, lines.size() - 1);
+    std::uniform_int_distribution<int> pick_count( 0, 6);
+
+    check_result result{ "read_x10_basic matches the fields of the message", 0, 0, {}};
+    for (int round = 0; round < 100000; ++round)
+    {
+        std::string datagram = "xpl-cmnd\n{\nhop=1\ntarget=*\n}\nx10.basic\n{\n";
+        const int count = pick_count( random);
+        for (int line = 0; line < count; ++line)
+        {
+            datagram += lines[pick_line( random)] + "\n";
+        }
+        datagram += "}\n";
+
+        xpl::message_view view;
+        if (!xpl::parse_datagram( datagram.data(), datagram.size(), view)) continue;
+        const auto message = view.to_message();
+        xpl::x10_basic from_view;
+        xpl::x10_basic from_message;
+        const bool view_complete = xpl::read_x10_basic( view, from_view);
+        const bool message_complete = reference_x10_basic( message.body, from_message);
+
+        ++result.cases;
+        if (view_complete != message_complete || !same_x10_basic( from_view, from_message))
+        {
+            if (!result.failures++) result.example = datagram;
+        }
+    }
+    return result;
+}
+
+/// returns whether an edge encoded waveform expands to the given samples, from the start and from random frames.
+bool expands_to( const waveform &compressed, const char *samples, std::size_t frames, std::mt19937 &random)
+{
+    if (!compressed.edges || compressed.frame_count() != frames) return false;
+
+    const auto frame_size = compressed.frame_size();
+    std::uniform_int_distribution<std::size_t> pick_frame( 0, frames - 1);
+    std::vector<char> expanded( frames * frame_size);
+    for (int round = 0; round < 1000; ++round)
+    {
+        const auto first = round ? pick_frame( random) : 0;
+        const auto count = round ? std::min<std::size_t>( 1 + pick_frame( random) % 2048, frames - first) : frames;
+        compressed.render( expanded.data(), first, count);
+        if (!std::equal( expanded.begin(), expanded.begin() + count * frame_size, samples + first * frame_size))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Check that the codes of the built-in RF protocols, rendered at common sample rates, are edge encoded and
+/// expand to exactly the samples of the uncompressed code. The codes are also converted to the stereo 24-bit
+/// format of a typical USB sound card, where the encoding must expand to the converted samples. The ratio
+/// between the size of the samples and the size of the encoding of every code is measured as well.
+check_result check_edge_encoding( bench_runner &runner)
+{
+    static const std::vector<std::pair<std::string, std::string>> codes = {
+            { "pt2262", "0FFF0FFFFFF1"}, { "ev1527", "011010011100101001011100"}, { "ht6p20", "0110100111001010010111"}};
+    std::mt19937 random{ 20141109};
+
+    check_result result{ "edge encoded RF codes expand to their samples", 0, 0, {}};
+    for (const auto &code : codes)
+    {
+        const auto protocol = rf_protocol_from_settings( { { "protocol", code.first}});
+        for (unsigned int rate : { 22050, 44100, 48000, 96000})
+        {
+            waveform_cache compressed_cache{ 64 * 1024 * 1024, true};
+            waveform_cache plain_cache{ 64 * 1024 * 1024, false};
+            const auto compressed = rf_synthesizer{ compressed_cache}.render( protocol, code.second, rate);
+            const auto plain = rf_synthesizer{ plain_cache}.render( protocol, code.second, rate);
+            const auto name = code.first + " at " + std::to_string( rate) + " Hz";
+
+            ++result.cases;
+            if (!expands_to( compressed, plain.data(), plain.frame_count(), random) && !result.failures++)
+            {
+                result.example = name;
+            }
+
+            const riff_fmt native{ 1, 2, rate, rate * 6, 6, 24};
+            waveform_cache native_cache{ 64 * 1024 * 1024, true};
+            native_cache.convert_to( native);
+            const auto converted = rf_synthesizer{ native_cache}.render( protocol, code.second, rate);
+            const auto samples = convert_samples( plain.fmt, plain.data(), plain.frame_count(), native);
+
+            ++result.cases;
+            if (!expands_to( converted, samples.data(), samples.size() / 6, random) && !result.failures++)
+            {
+                result.example = name + ", converted to stereo 24-bit";
+            }
+
+            runner.add_measurement( { "edge encoding ratio, " + name,
+                static_cast<double>( plain.memory_size()) / compressed.memory_size()});
+        }
+    }
+    return result;
+}
+
+/// Create the bytes of a 16-bit mono wav file with 'frames' frames of a square wave.
+std::string make_wav_file( std::size_t frames)
+{
+    std::ostringstream file;
+    const auto le = [&file]( std::uint32_t value, unsigned int bytes)
+            {
+                for (unsigned int byte = 0; byte < bytes; ++byte) file.put( static_cast<char>( value >> (8 * byte)));
+            };
+    const std::uint32_t data_size = frames * 2;
+    file.write( "RIFF", 4);
+    le( 36 + data_size, 4);
+    file.write( "WAVEfmt ", 8);
+    le( 16, 4);
+    le( 1, 2);
+    le( 1, 2);
+    le( 48000, 4);
+    le( 96000, 4);
+    le( 2, 2);
+    le( 16, 2);
+    file.write( "data", 4);
+    le( data_size, 4);
+    for (std::size_t frame = 0; frame < frames; ++frame)
+    {
+        le( static_cast<std::uint16_t>( (frame / 24) % 2 ? 32767 : -32767), 2);
+    }
+    return file.str();
+}
+
+/// Create a waveform of 'frames' frames of a square wave, stored as samples or as an edge encoding.
+waveform make_waveform( std::size_t frames, bool compress)
+{
+    waveform_cache cache{ 64 * 1024 * 1024, compress};
+    waveform::sample_buffer samples( frames * 2);
+    for (std::size_t frame = 0; frame < frames; ++frame)
+    {
+        const std::int16_t value = (frame / 24) % 2 ? 32767 : -32767;
+        samples[2 * frame] = static_cast<char>( value & 0xff);
+        samples[2 * frame + 1] = static_cast<char>( (value >> 8) & 0xff);
+    }
+    return cache.insert( { 1, 1, 48000, 96000, 2, 16}, std::move( samples));
+}
+
+void parser_benchmarks( bench_runner &runner)
+{
+    runner.run( "datagram_parser::feed_line", command_datagram.size(), []()
+            {
+                sink_value = parse_lines( command_datagram).body.size();
+            });
+
+    xpl::message_view view;
+    runner.run( "parse_datagram", command_datagram.size(), [&view]()
+            {
+                if (!xpl::parse_datagram( command_datagram.data(), command_datagram.size(), view))
+                {
+                    throw std::runtime_error( "could not parse datagram");
+                }
+                sink_value = view.field_count;
+            });
+
+    // parse_header() stops at the body of the datagram, so it doesn't read the whole input.
+    runner.run( "parse_header (heartbeat)", 0, [&view]()
+            {
+                sink_value = xpl::parse_header( heartbeat_datagram.data(), heartbeat_datagram.size(), view);
+            });
+
+    runner.run( "parse_datagram + to_message", command_datagram.size(), [&view]()
+            {
+                xpl::parse_datagram( command_datagram.data(), command_datagram.size(), view);
+                sink_value = view.to_message().body.size();
+            });
+
+    const auto message = parse_lines( command_datagram);
+    runner.run( "to_string", 0, [&message]()
+            {
+                sink_value = xpl::to_string( message).size();
+            });
+
+    xpl::x10_basic command;
+    xpl::parse_datagram( command_datagram.data(), command_datagram.size(), view);
+    runner.run( "read_x10_basic", 0, [&view, &command]()
+            {
+                sink_value = xpl::read_x10_basic( view, command);
+            });
+
+    std::string buffer;
+    const xpl::key_order order{ "command", "device"};
+    runner.run( "serialize (reused buffer)", 0, [&message, &buffer, &order]()
+            {
+                buffer.clear();
+                xpl::serialize( message, buffer, order);
+                sink_value = buffer.size();
+            });
+
+    std::ostringstream stream;
+    runner.run( "map_to_stream", 0, [&message, &stream]()
+            {
+                stream.str( std::string{});
+                xpl::map_to_stream( message.body, stream);
+                sink_value = static_cast<std::size_t>( stream.tellp());
+            });
+}
+
+void service_benchmarks( bench_runner &runner)
+{
+    xpl::application_service service{ "cheapl-bench.bench", "0.1"};
+    std::size_t handled = 0;
+    service.register_command( "x10.basic", [&handled]( const xpl::message &) { ++handled;});
+
+    const auto message = parse_lines( command_datagram);
+    runner.run( "application_service::handle_message", 0, [&service, &message]()
+            {
+                xpl::bench_access::handle_message( service, message);
+            });
+    sink_value = handled;
+
+    runner.run( "application_service::send_heartbeat_message", 0, [&service]()
+            {
+                xpl::bench_access::send_heartbeat_message( service);
+            });
+}
+
+void schema_benchmarks( bench_runner &runner)
+{
+    xpl::schema_table table;
+    table.intern( "sensor.basic");
+    const boost::string_view builtin{ "x10.basic"};
+    const boost::string_view registered{ "sensor.basic"};
+    const boost::string_view unknown{ "control.basic"};
+
+    runner.run( "schema_table::find (built-in)", 0, [&table, &builtin]()
+            {
+                sink_value = table.find( builtin);
+            });
+    runner.run( "schema_table::find (registered)", 0, [&table, &registered]()
+            {
+                sink_value = table.find( registered);
+            });
+    runner.run( "schema_table::find (unknown)", 0, [&table, &unknown]()
+            {
+                sink_value = table.find( unknown);
+            });
+}
+
+void wav_benchmarks( bench_runner &runner)
+{
+    for (std::size_t frames : {4800, 4 * 1024 * 1024})
+    {
+        const auto file = make_wav_file( frames);
+        const auto suffix = " (" + std::to_string( file.size() / 1024) + " KiB)";
+        // only the headers of the file are parsed, so there is no meaningful throughput to report.
+        runner.run( "parse_wavfile memory" + suffix, 0, [&file]()
+                {
+                    wav_file result;
+                    if (!parse_wavfile( reinterpret_cast<const std::uint8_t *>( file.data()), file.size(), result))
+                    {
+                        throw std::runtime_error( "could not parse wav file");
+                    }
+                    sink_value = result.data.size;
+                });
+
+        std::istringstream stream( file);
+        runner.run( "parse_wavfile stream" + suffix, 0, [&stream]()
+                {
+                    stream.clear();
+                    stream.seekg( 0);
+                    wav_file result;
+                    if (!parse_wavfile( stream, result)) throw std::runtime_error( "could not parse wav file");
+                    sink_value = result.data.size;
+                });
+    }
+}
+
+/// Play a waveform to a null sink that consumes frames as fast as they are written and wait until the
+/// playback queue reports that it was transmitted.
+void playback_benchmarks( bench_runner &runner)
+{
+    for (bool compressed : {false, true})
+    {
+        null_sink sink{ false};
+        playback_queue queue{ sink, 16, std::chrono::milliseconds{ 0}};
+        const auto wav = make_waveform( 48000, compressed);
+
+        std::mutex mutex;
+        std::condition_variable done;
+        bool finished = false;
+        runner.run( compressed ? "playback null sink (edge encoded)" : "playback null sink (samples)",
+                wav.frame_count() * wav.frame_size(),
+                [&]()
+                {
+                    finished = false;
+                    playback_job job{ wav, [&]()
+                            {
+                                std::lock_guard<std::mutex> lock( mutex);
+                                finished = true;
+                                done.notify_one();
+                            },
+                            0, {}, 1, std::chrono::milliseconds{ 0}};
+                    if (!queue.push( std::move( job))) throw std::runtime_error( "playback queue is full");
+                    std::unique_lock<std::mutex> lock( mutex);
+                    done.wait( lock, [&finished](){ return finished;});
+                });
+    }
+}
+}
+
+int main( int argc, char *argv[])
+{
+    std::chrono::milliseconds min_time{ 250};
+    std::string filter;
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        const std::string option = argv[arg];
+        if (option.compare( 0, 11, "--min-time=") == 0)
+        {
+            min_time = std::chrono::milliseconds{ std::stoul( option.substr( 11))};
+        }
+        else if (option.compare( 0, 9, "--filter=") == 0)
+        {
+            filter = option.substr( 9);
+        }
+        else
+        {
+            std::cerr << "usage: cheapl_bench [--min-time=<ms>] [--filter=<text>]\n";
+            return 1;
+        }
+    }
+
+    try
+    {
+        bench_runner runner{ min_time, filter};
+        runner.add_check( check_datagram_parser());
+        runner.add_check( check_x10_basic());
+        runner.add_check( check_edge_encoding( runner));
+        parser_benchmarks( runner);
+        service_benchmarks( runner);
+        schema_benchmarks( runner);
+        wav_benchmarks( runner);
+        playback_benchmarks( runner);
+        runner.write_json( std::cout);
+        if (!runner.checks_passed()) return 1;
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "something went wrong: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
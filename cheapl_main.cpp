@@ -22,6 +22,8 @@ struct config
     string usb_device           {"Generic USB Audio Device"};
     string application_id       {"rurandom-cheapl." + truncateto16( boost::asio::ip::host_name())};
     string application_version  {"0.1"};
+    xpl::cheapl_options options;
+    bool tune = false;
 private:
     static std::string truncateto16( const std::string &input)
     {
@@ -31,22 +33,134 @@ private:
 };
 
 
+/// Interpret the value of a command line option as a boolean.
+/// An option without a value, like "--tune", counts as "yes".
+bool to_bool( const string &value)
+{
+    if (value.empty() || value == "yes" || value == "on" || value == "true" || value == "1") return true;
+    if (value == "no" || value == "off" || value == "false" || value == "0") return false;
+    throw std::runtime_error( "expected a boolean value (yes/no) instead of '" + value + "'");
+}
+
+/// Handle a single command line option of the form --<name>=<value>.
+void set_option( config &result, const string &option)
+{
+    const auto equals = option.find( '=');
+    const string name = option.substr( 2, equals - 2);
+    const string value = equals == string::npos ? "" : option.substr( equals + 1);
+
+    if (name == "memory-budget")
+    {
+        // budget is given in MiB
+        result.options.memory_budget = std::stoul( value) * 1024 * 1024;
+    }
+    else if (name == "compress")
+    {
+        result.options.compress_waveforms = to_bool( value);
+    }
+    else if (name == "queue-length")
+    {
+        result.options.queue_length = std::stoul( value);
+    }
+    else if (name == "gap")
+    {
+        result.options.inter_code_gap = std::chrono::milliseconds( std::stoul( value));
+    }
+    else if (name == "acknowledge")
+    {
+        if (value == "transmission")
+        {
+            result.options.acknowledge = xpl::acknowledge_mode::after_transmission;
+        }
+        else if (value == "enqueue")
+        {
+            result.options.acknowledge = xpl::acknowledge_mode::on_enqueue;
+        }
+        else
+        {
+            throw std::runtime_error( "acknowledge should be either 'transmission' or 'enqueue'");
+        }
+    }
+    else if (name == "card")
+    {
+        result.options.additional_cards.push_back( value);
+    }
+    else if (name == "dual-transmitter")
+    {
+        result.options.dual_transmitter = to_bool( value);
+    }
+    else if (name == "playback")
+    {
+        if (value == "thread")
+        {
+            result.options.playback = xpl::playback_mode::thread;
+        }
+        else if (value == "event")
+        {
+            result.options.playback = xpl::playback_mode::event_loop;
+        }
+        else
+        {
+            throw std::runtime_error( "playback should be either 'thread' or 'event'");
+        }
+    }
+    else if (name == "tune")
+    {
+        result.tune = to_bool( value);
+    }
+    else if (name == "trim")
+    {
+        result.options.trim_silence = to_bool( value);
+    }
+    else if (name == "trim-guard")
+    {
+        result.options.trim_guard = std::chrono::milliseconds( std::stoul( value));
+    }
+    else if (name == "native-format")
+    {
+        result.options.native_format = to_bool( value);
+    }
+    else if (name == "fast-start")
+    {
+        result.options.fast_start = to_bool( value);
+    }
+    else if (name == "mmap")
+    {
+        result.options.use_mmap = to_bool( value);
+    }
+    else
+    {
+        throw std::runtime_error( "unknown option: " + option);
+    }
+}
+
 /// Simple configuration retrieval function.
 /// For now, let's stick with a _very_ simple command line parser.
+/// Arguments that start with "--" are options, all other arguments are positional.
 config get_config( int argc, char *argv[])
 {
     config result;
 
     // little known fact: argv ends with a nullptr
     ++argv; // get past the program name
-    if (*argv)
-    {
-        result.soundfile_directory = *argv++;
-    }
-
-    if (*argv)
+    int position = 0;
+    for (; *argv; ++argv)
     {
-        result.usb_device = *argv++;
+        const string argument = *argv;
+        if (argument.compare( 0, 2, "--") == 0)
+        {
+            set_option( result, argument);
+        }
+        else if (position == 0)
+        {
+            result.soundfile_directory = argument;
+            ++position;
+        }
+        else if (position == 1)
+        {
+            result.usb_device = argument;
+            ++position;
+        }
     }
 
     return result;
@@ -67,6 +181,7 @@ void exit_handler(void) noexcept
 /// This program currently takes two optional arguments:
 /// # the directory where wav-files can be found that should be played to the RF-connected sound card.
 /// # the name of the alsa sound device to which the sequences should be sent.
+/// Additionally, options of the form --<name>=<value> may be given, see set_option().
 int main( int argc, char *argv[])
 {
     int result = 0;
@@ -74,7 +189,12 @@ int main( int argc, char *argv[])
     {
         atexit(exit_handler);
         config conf = get_config( argc, argv);
-        service_ptr.reset( new xpl::cheapl_service{ conf.soundfile_directory, conf.usb_device, conf.application_id, conf.application_version});
+        if (conf.tune)
+        {
+            xpl::cheapl_service::tune_cards( conf.soundfile_directory, conf.usb_device, conf.options, std::cout);
+            return 0;
+        }
+        service_ptr.reset( new xpl::cheapl_service{ conf.soundfile_directory, conf.usb_device, conf.application_id, conf.application_version, conf.options});
         service_ptr->run();
     }
     catch (std::exception &e)
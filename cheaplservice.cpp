@@ -13,25 +13,84 @@
 #include <boost/algorithm/string.hpp>
 #include "cheaplservice.h"
 #include "alsa_wrapper.hpp"
-#include "audiofiles/include/wav_parser.hpp"
 #include "audiofiles/include/wav_file.hpp"
+#include "waveform_cache.h"
+#include "playback_queue.h"
+#include "async_playback.h"
+#include "audio_sink.h"
+#include "rf_synthesizer.h"
+#include "settings_file.h"
+#include "latency_histogram.h"
+#include "pcm_tuner.h"
 #include "xpl_application_service.h"
 #include "datagramparser.h"
+#include "x10_schema.h"
 
+#include <algorithm>
+#include <array>
 #include <utility>
-#include <fstream>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <csignal>
 
 namespace bf = boost::filesystem;
 
 namespace {
 
-/// Find a PCM output device for the alsa sound card with the given name.
-std::pair<int, int> find_card_pcm( const std::string &cardname)
+/// default sample rate of synthesized codes. Most USB sound cards run at 48kHz natively.
+const unsigned int synthesis_rate = 48000;
+
+/// upper limit to the number of repeats of a command, so that a single message can't occupy a transmitter for long.
+const unsigned long maximum_repeats = 100;
+
+/// Parse a repeat count, limiting it to between 1 and maximum_repeats.
+unsigned int repeat_count( const std::string &text)
+{
+    return static_cast<unsigned int>( std::min( std::max( std::stoul( text), 1ul), maximum_repeats));
+}
+
+/// Parse a repeat count from a message without throwing, limiting it to between 1 and maximum_repeats.
+/// Returns false, leaving 'count' as it was, if the text doesn't start with a number.
+bool parse_repeat_count( boost::string_view text, unsigned int &count)
+{
+    unsigned long value = 0;
+    std::size_t digits = 0;
+    for (; digits < text.size() && text[digits] >= '0' && text[digits] <= '9'; ++digits)
+    {
+        value = std::min( value * 10 + (text[digits] - '0'), maximum_repeats);
+    }
+    if (!digits) return false;
+    count = static_cast<unsigned int>( std::max( value, 1ul));
+    return true;
+}
+
+/// Find a PCM output device for an alsa sound card.
+/// The card can be given by its name, by its name followed by "#<n>" to select the n-th card with that name
+/// (for when several identical cards are plugged in), or by its alsa card index.
+std::pair<int, int> find_card_pcm( const std::string &cardspec)
 {
+    std::string cardname = cardspec;
+    int cardindex = -1;
+    unsigned int occurrence = 1;
+    const auto hash = cardspec.rfind( '#');
+    if (!cardspec.empty() && cardspec.find_first_not_of( "0123456789") == std::string::npos)
+    {
+        cardindex = std::stoi( cardspec);
+    }
+    else if (hash != std::string::npos && hash + 1 < cardspec.size()
+            && cardspec.find_first_not_of( "0123456789", hash + 1) == std::string::npos)
+    {
+        cardname = cardspec.substr( 0, hash);
+        occurrence = std::stoul( cardspec.substr( hash + 1));
+    }
+
     auto &alsa( alsalib::get_instance());
     for (auto card : alsa.get_cards())
     {
-        if (card.get_name() == cardname)
+        const bool match = cardindex >= 0 ? card.get_index() == cardindex : card.get_name() == cardname;
+        if (match && (cardindex >= 0 || !--occurrence))
         {
             auto &pcmdevices = card.pcm_devices();
             // get the first pcm device
@@ -41,92 +100,213 @@ std::pair<int, int> find_card_pcm( const std::string &cardname)
             }
             else
             {
-                throw std::runtime_error("card '" + cardname +"' doesn't have any pcm devices");
+                throw std::runtime_error("card '" + cardspec +"' doesn't have any pcm devices");
             }
         }
     }
-    throw std::runtime_error("could not find sound card with name: " + cardname);
+    throw std::runtime_error("could not find sound card: " + cardspec);
 }
 
-/// Find an alsa sound card with the given name.
-soundcard find_card( const std::string &name)
+/// name of the file in which the period and buffer size of a sound card are stored.
+bf::path tuning_file( const bf::path &directory, const std::string &cardname)
 {
-    alsalib &alsa( alsalib::get_instance());
-    for (auto card : alsa.get_cards())
+    return directory / (cardname + ".tuning");
+}
+
+/// Create a sink that doesn't need a sound card, if the card specification asks for one.
+/// "null" and "wav:<filename>" play in real time, "null-fast" and "wav-fast:<filename>" consume every frame
+/// as soon as it is written. Returns a null pointer for specifications of alsa sound cards.
+std::unique_ptr<audio_sink> open_virtual_sink( const std::string &cardspec)
+{
+    static const boost::regex sink_regex{ R"(^(null|wav)(-fast)?(?::(.*))?$)"};
+    boost::smatch match;
+    if (!regex_match( cardspec, match, sink_regex)) return {};
+
+    const bool real_time = !match[2].matched;
+    if (match[1] == "null") return std::unique_ptr<audio_sink>{ new null_sink{ real_time}};
+    if (!match[3].matched || match[3].str().empty())
     {
-        if (card.get_name() == name) return card;
+        throw std::runtime_error( "sound card '" + cardspec + "' should name a file, like wav:output.wav");
     }
-    throw std::runtime_error("could not find sound card with name: " + name);
+    return std::unique_ptr<audio_sink>{ new wav_file_sink{ match[3], real_time}};
 }
 
-/// convert a size in bits into a SND_PCM enum value for use in alsa functions.
-snd_pcm_format_t bitsize_to_pcm_format( unsigned int bitsize)
-{
-    if (bitsize <= 8) return SND_PCM_FORMAT_U8;
-    if (bitsize <= 16) return SND_PCM_FORMAT_S16_LE;
-    if (bitsize <= 24) return SND_PCM_FORMAT_S24_LE;
-    if (bitsize <= 32) return SND_PCM_FORMAT_S32_LE;
-    throw std::runtime_error( "don't know how to handle samples of bitsize " + std::to_string( bitsize));
 }
 
-/// Given a riff_fmt object that was the result of parsing a wav-file, push the wav-file attributes such
-/// as sample rate and channel count to the given pcm device.
-void set_parameters_from_wav( opened_pcm_device &device, const riff_fmt &format)
+namespace xpl
 {
-    device.format( bitsize_to_pcm_format(format.bits_per_sample));
-    device.rate( {format.samplerate, 0});
-    device.channels( format.channels);
-    device.access( SND_PCM_ACCESS_RW_INTERLEAVED);
-}
 
-/// play the contents of the given wav-file to the given alsa pcm device.
-void play_wav( opened_pcm_device &device, const std::string &wavfilename)
+/// Everything that is needed to play waveforms on a single sound card, or on a sink that stands in for one.
+/// Every sound card has its own waveforms, so that each card has its own memory budget, and its own
+/// player, so that cards transmit concurrently.
+/// The player either has a playback thread of its own, or writes to the device from the io_service thread.
+struct sound_output
 {
-    wav_file wav;
-    std::ifstream wavfile(wavfilename, std::ios::binary);
-    if (!parse_wavfile( wavfile,wav)) throw std::runtime_error("parsing file " + wavfilename + " failed");
-
-    device.period_size( {128, 0});
-    set_parameters_from_wav( device, wav.fmt);
-    device.commit_parameters();
-
-    const unsigned int actual_period_size = device.period_size().first;
-    const auto framesize = wav.fmt.channels * wav.fmt.bits_per_sample/8 ;
-    const auto buffersize = framesize * actual_period_size;
-
-    auto framestogo = wav.data.size/ framesize;
-    wavfile.seekg( wav.data.pos, std::ios::beg);
-    std::vector<char> buffer(buffersize);
-    while (framestogo)
+    sound_output(
+            const std::string &cardname, const bf::path &directory, const cheapl_options &options,
+            boost::asio::io_service &io_service, latency_statistics &latencies)
+    :name{ cardname},
+     sink{ open_virtual_sink( cardname)},
+     waveforms{ options.memory_budget, options.compress_waveforms},
+     synthesizer{ waveforms}
     {
-        const auto framecount = std::min( actual_period_size, framestogo);
-        wavfile.read( &buffer.front(), framecount * framesize);
-        device.writei( &buffer.front(), framecount);
-        framestogo -= framecount;
+        if (!sink)
+        {
+            auto alsa = new alsa_sink{ find_card_pcm( cardname), options.native_format};
+            sink.reset( alsa);
+            pcm_device = &alsa->pcm();
+        }
+
+        if (options.native_format && options.dual_transmitter)
+        {
+            throw std::runtime_error( "dual transmitter mode can't be combined with native format playback");
+        }
+        if (options.native_format && pcm_device)
+        {
+            // convert all waveforms to the format of the hardware when they are loaded.
+            const auto native = pcm_device->native_configuration( synthesis_rate);
+            const uint16_t bits = snd_pcm_format_physical_width( native.format);
+            const uint16_t framesize = native.channels * bits / 8;
+            waveforms.convert_to( { 1, static_cast<uint16_t>( native.channels), native.rate, native.rate * framesize, framesize, bits});
+            rate = native.rate;
+        }
+
+        if (options.trim_silence) waveforms.trim_silence( options.trim_guard);
+        if (pcm_device)
+        {
+            pcm_device->set_start_profile( options.fast_start ? pcm_start_profile::fast_start : pcm_start_profile::buffered);
+
+            // use the period and buffer size that were found with --tune, if any.
+            const auto tuning = tuning_file( directory, cardname);
+            if (bf::exists( tuning)) pcm_device->set_buffering( read_buffering( tuning.string()));
+        }
+
+        if (options.playback == playback_mode::event_loop)
+        {
+            if (options.dual_transmitter)
+            {
+                throw std::runtime_error( "dual transmitter mode needs a playback thread for every sound card");
+            }
+            // non-blocking writes are done with snd_pcm_writei(), so mmap access is not used.
+            if (pcm_device) pcm_device->enable_mmap( false);
+            async_player.reset( new async_playback{ io_service, *sink, options.queue_length, options.inter_code_gap, &latencies});
+        }
+        else
+        {
+            if (pcm_device) pcm_device->enable_mmap( options.use_mmap);
+            player.reset( new playback_queue{
+                *sink, options.queue_length, options.inter_code_gap, options.dual_transmitter, &latencies});
+        }
     }
 
-    device.drain();
-}
+    /// Schedule a waveform to be played, returns false if the player can't take more jobs.
+    bool push( playback_job job)
+    {
+        return player ? player->push( std::move( job)) : async_player->push( std::move( job));
+    }
 
-}
+    std::string         name;      ///< name of the sound card, as given in the configuration
+    unsigned int        rate = synthesis_rate; ///< default sample rate for synthesized codes
+    std::unique_ptr<audio_sink> sink;  ///< where the waveforms are played: a sound card, a file or nowhere
+    opened_pcm_device   *pcm_device = nullptr;///< the alsa pcm device of the sink, if it plays to a sound card.
+    waveform_cache      waveforms; ///< the sample data of all waveforms that can be played to the sink
+    rf_synthesizer      synthesizer;///< renders RF codes into waveforms
+    std::unique_ptr<playback_queue> player;      ///< plays waveforms to the sink on a separate thread
+    std::unique_ptr<async_playback> async_player;///< plays waveforms to the sink from the io_service thread
+};
 
-namespace xpl
+/// The pair of replies that confirm a command, rendered in advance.
+struct cheapl_service::confirmation
 {
+    std::shared_ptr<const std::string> basic;   ///< xpl-trig message with schema x10.basic
+    std::shared_ptr<const std::string> confirm; ///< xpl-trig message with schema x10.confirm
+};
 
 /// Implementation of the pimpl (bridge)-pattern.
 /// This struct contains the private members of the cheapl service.
 struct cheapl_service::impl
 {
-    /// mapping from command names to wave files
-    using onoffmap = std::map< std::string, bf::path>;
+    impl(
+            const std::string& directoryname,
+            const std::string& soundcardname,
+            const std::string& application_id,
+            const std::string& application_version,
+            const cheapl_options& options)
+    :service{ application_id, application_version},
+     directory{ directoryname},
+     acknowledge{ options.acknowledge},
+     dual_transmitter{ options.dual_transmitter},
+     repeat_gap{ options.inter_code_gap}
+    {
+        outputs.emplace_back( new sound_output{ soundcardname, directory, options, service.get_io_service(), latencies});
+        for (const auto &card : options.additional_cards)
+        {
+            outputs.emplace_back( new sound_output{ card, directory, options, service.get_io_service(), latencies});
+        }
+    }
+
+    /// waveforms of the "on" and "off" commands, indexed by x10_command.
+    using onoffarray = std::array< waveform, 2>;
+
+    /// everything needed to send commands to a single device.
+    struct device_info
+    {
+        onoffarray      commands;
+        std::array< confirmation, 2> confirmations; ///< replies to the "on" and "off" commands
+        sound_output    *output = nullptr; ///< sound card that the transmitter of this device is connected to
+        std::chrono::microseconds trimmed{ 0}; ///< silence that was cut from the recordings of this device
+        unsigned int    channel = 0; ///< output channel of the transmitter, in dual transmitter mode
+        unsigned int    repeats = 1; ///< number of times that a command is played
+        std::chrono::milliseconds repeat_gap{ 0}; ///< silence between repeats of a command
+    };
+
+    /// mapping from device names to device information
+    using lightsmap = std::map< std::string, device_info>;
 
-    /// mapping from device names to command maps
-    using lightsmap = std::map< std::string, onoffmap>;
+    /// the entries of the lights map, sorted by name, to look devices up by a name that isn't a std::string.
+    using device_index = std::vector< std::pair< boost::string_view, const device_info *>>;
 
     application_service service; ///< xPl service object
     bf::path            directory;///< directory with wav-files
-    lightsmap           lights;   ///< mapping of device names and command strings to wav-files
-    opened_pcm_device   pcm_device;///< an opened alsa pcm device.
+    lightsmap           lights;   ///< mapping of device names and command strings to waveforms
+    device_index        devices;  ///< index of 'lights', for handling commands
+    latency_statistics  latencies;///< time that commands spend in every stage, from receive to transmission
+    std::vector<std::unique_ptr<sound_output>> outputs; ///< all sound cards, the first one is the default.
+    acknowledge_mode    acknowledge;///< when to send the confirmation of a command
+    bool                dual_transmitter;///< whether the left and right channel drive separate transmitters
+    std::chrono::milliseconds repeat_gap;///< silence between repeats, for devices that don't specify it
+
+    /// Find the sound card that a device is routed to by its settings.
+    sound_output &route( const std::string &device, const settings_map &settings)
+    {
+        const auto card = settings.find( "card");
+        if (card == settings.end()) return *outputs.front();
+        for (const auto &output : outputs)
+        {
+            if (output->name == card->second) return *output;
+        }
+        throw std::runtime_error( "device " + device + " is routed to sound card '" + card->second + "', which is not configured");
+    }
+
+    /// Rebuild the device index after devices were added to 'lights'.
+    void index_devices()
+    {
+        devices.clear();
+        for (const auto &device : lights)
+        {
+            devices.emplace_back( device.first, &device.second);
+        }
+    }
+
+    /// returns the device with the given name, or nullptr if there is no such device.
+    const device_info *find_device( boost::string_view name) const
+    {
+        using entry = device_index::value_type;
+        const auto found = std::lower_bound( devices.begin(), devices.end(), name,
+                []( const entry &device, boost::string_view name) { return device.first < name;});
+        if (found == devices.end() || found->first != name) return nullptr;
+        return found->second;
+    }
 };
 
 /// Construct an xPL service.
@@ -135,22 +315,18 @@ cheapl_service::cheapl_service(
         const std::string& directoryname, ///< directory containing wav files to be played
         const std::string& soundcardname, ///< the alsa name of the soundcard device to which the wav files will be played
         const std::string& application_id,///< application id that will appear in xPL messages.
-        const std::string& application_version ///< application version that will appear in xPL messages
+        const std::string& application_version, ///< application version that will appear in xPL messages
+        const cheapl_options& options           ///< additional settings
         )
-:pimpl{
-    new impl{
-        {application_id, application_version}, // application service
-        directoryname,                          // directory
-        {},                                     // lights map
-        {find_card_pcm( soundcardname), SND_PCM_STREAM_PLAYBACK} // pcm device
-
-    }
-}
+:pimpl{ new impl{ directoryname, soundcardname, application_id, application_version, options}}
 {
     // register our function that handles x10.basic commands
-    get_impl().service.register_command( "x10.basic",
+    get_impl().service.register_command_view( "x10.basic",
+            [this]( const message_view &view){ handle_command( view);},
             [this]( const message &m){ handle_command( m);});
 
+    get_impl().service.register_signal( SIGUSR1, [this](){ report( std::cout);});
+
     scan_files(directoryname);
 }
 
@@ -179,6 +355,36 @@ void cheapl_service::list_cards( std::ostream& output)
     }
 }
 
+/// Find the best period and buffer size for the given sound card and for any additional sound cards in the options.
+/// Every card is tried with a range of period and buffer sizes, after which the best combination is stored in
+/// a file in the given directory. Services that are started later with the same directory use these sizes.
+/// A report of the measurements is written to 'output'.
+void cheapl_service::tune_cards(
+        const std::string &directoryname, const std::string &soundcardname,
+        const cheapl_options &options, std::ostream& output)
+{
+    std::vector<std::string> cards{ soundcardname};
+    cards.insert( cards.end(), options.additional_cards.begin(), options.additional_cards.end());
+    for (const auto &card : cards)
+    {
+        if (open_virtual_sink( card))
+        {
+            output << "'" << card << "' is not a sound card, skipping it\n";
+            continue;
+        }
+        output << "tuning sound card '" << card << "'\n";
+        opened_pcm_device device{ find_card_pcm( card), SND_PCM_STREAM_PLAYBACK};
+        device.enable_mmap( options.use_mmap);
+        device.set_start_profile( options.fast_start ? pcm_start_profile::fast_start : pcm_start_profile::buffered);
+
+        const auto best = tune_buffering( device, synthesis_rate, output);
+        const auto file = tuning_file( directoryname, card);
+        write_buffering( file.string(), best);
+        output << "using a period of " << best.period_size << " frames and a buffer of " << best.buffer_size
+                << " frames, stored in " << file.string() << '\n';
+    }
+}
+
 /// Pimpl pattern: return the internal impl object
 cheapl_service::impl& cheapl_service::get_impl()
 {
@@ -191,6 +397,36 @@ void cheapl_service::signoff()
     get_impl().service.send_termination_message();
 }
 
+/// Write statistics about the sound devices to the given output stream.
+void cheapl_service::report( std::ostream& output) const
+{
+    for (const auto &sound : get_impl().outputs)
+    {
+        const auto statistics = sound->sink->statistics();
+        output << "pcm device '" << sound->name << "': "
+                << statistics.reconfigurations << " reconfigurations ("
+                << statistics.negotiations << " negotiated, "
+                << statistics.reconfigurations - statistics.negotiations << " from cache), "
+                << statistics.reuses << " transmissions without reconfiguration, "
+                << statistics.underruns << " underruns\n";
+        const auto used = sound->waveforms.memory_used();
+        output << "waveforms: " << used << " bytes in memory for "
+                << sound->waveforms.uncompressed_size() << " bytes of samples (ratio "
+                << (used ? sound->waveforms.uncompressed_size() / used : 0) << "), "
+                << sound->waveforms.trimmed_time().count() / 1000 << "ms of silence cut from recordings\n";
+    }
+    for (const auto &device : get_impl().lights)
+    {
+        if (device.second.trimmed.count())
+        {
+            output << "device " << device.first << ": " << device.second.trimmed.count() / 1000
+                    << "ms of airtime saved for every on/off pair by trimming silence\n";
+        }
+    }
+    get_impl().latencies.report( output);
+    output.flush();
+}
+
 /// Pimpl pattern: return the internal impl object
 const cheapl_service::impl& cheapl_service::get_impl() const
 {
@@ -200,49 +436,151 @@ const cheapl_service::impl& cheapl_service::get_impl() const
 /// Handle x10 command messages.
 /// This function is registered with the xPL service so that incoming
 /// command messages of schema type x10.basic are handled.
-/// This handler recognizes the "on" and "off" command and plays the appropriate
-/// wav-file for the device that is specified in the command message.
+/// This handler recognizes the "on" and "off" command and queues the appropriate
+/// waveform for the device that is specified in the command message. Depending on the
+/// acknowledge mode, the command is confirmed once the waveform has been transmitted
+/// or as soon as it has been queued.
+/// An optional "repeat" key in the message overrides the number of times that the device plays a command.
+/// The message arrives as a view of its datagram, so that a command is queued without copying any text.
+void cheapl_service::handle_command( const message_view& view)
+{
+    // messages without a command or device are silently ignored.
+    x10_basic command;
+    if (!read_x10_basic( view, command)) return;
+    queue_command( command, view.field_count - view.header_count == 2, view.received, view.parsed,
+            [&view](){ return view.to_message();});
+}
+
+/// Handle x10 command messages that have more fields than a message view can hold.
+/// @see handle_command( const message_view &)
 void cheapl_service::handle_command( const message& m)
 {
-    try {
-        const auto &command = m.body.at("command");
-        const auto &device = m.body.at("device");
-        if (command == "on" || command == "off")
+    x10_basic command;
+    if (!read_x10_basic( m.body, command)) return;
+    queue_command( command, m.body.size() == 2, m.received, m.parsed, [&m](){ return m;});
+}
+
+/// Queue the waveform for an x10 command that was read from a message and arrange for its confirmation.
+/// 'bare' tells whether the message has no other fields than the command and the device, in which case
+/// the pre-rendered confirmation is sent. Otherwise, make_message() is called to create the message that is
+/// echoed.
+void cheapl_service::queue_command(
+        const x10_basic &command, bool bare, std::chrono::steady_clock::time_point received,
+        std::chrono::steady_clock::time_point parsed, const std::function<message ()> &make_message)
+{
+    // unknown commands and unknown devices are silently ignored.
+    if (command.command != x10_command::on && command.command != x10_command::off) return;
+    const auto info = get_impl().find_device( command.device);
+    if (!info) return;
+
+    playback_job job{
+        info->commands[static_cast<std::size_t>( command.command)], {}, info->channel, {}, info->repeats, info->repeat_gap};
+    // a repeat count that isn't a number is ignored, the device then uses its own repeat count.
+    parse_repeat_count( command.repeat, job.repeats);
+
+    // the rendered replies can be sent for commands that have nothing else than a command and a device,
+    // other commands are echoed with all their fields.
+    const confirmation *reply = bare ? &info->confirmations[static_cast<std::size_t>( command.command)] : nullptr;
+
+    sound_output &output = *info->output;
+    job.trace.received = received;
+    job.trace.parsed = parsed;
+    if (get_impl().acknowledge == acknowledge_mode::after_transmission)
+    {
+        // the confirmation is sent from the io_service thread, once the playback thread is done.
+        if (reply)
         {
-            const auto &device_wav = get_impl().lights.at(device).at(command);
-            // todo: delegate wav playing to a separate thread queue.
-            play_wav( get_impl().pcm_device, device_wav.string());
-            message reply( m);
-            reply.message_type = "xpl-trig";
-            reply.headers["target"] = "*";
-            get_impl().service.send( reply);
+            job.on_done = [this, reply](){
+                get_impl().service.post( [this, reply](){ send_confirmation( *reply);});
+            };
+        }
+        else
+        {
+            const auto m = make_message();
+            job.on_done = [this, m](){
+                get_impl().service.post( [this, m](){ send_confirmation( m);});
+            };
+        }
+    }
 
-            // send both an x10.basic and an x10.confirm message, because domogik
-            // wants an x10.basic (in error, I think).
-            reply.message_schema = "x10.confirm";
-            get_impl().service.send( reply);
+    job.trace.dispatched = std::chrono::steady_clock::now();
+    if (!output.push( std::move( job)))
+    {
+        std::cerr << "playback queue is full, dropping command '" << command.command_text << "' for device " << command.device << '\n';
+    }
+    else if (get_impl().acknowledge == acknowledge_mode::on_enqueue)
+    {
+        if (reply) send_confirmation( *reply);
+        else send_confirmation( make_message());
+    }
+}
 
+/// Send the replies that confirm that the given x10 command was executed.
+void cheapl_service::send_confirmation( const message& m)
+{
+    message reply( m);
+    reply.message_type = "xpl-trig";
+    reply.headers["target"] = "*";
+    get_impl().service.send( reply);
+
+    // send both an x10.basic and an x10.confirm message, because domogik
+    // wants an x10.basic (in error, I think).
+    reply.message_schema = "x10.confirm";
+    get_impl().service.send( reply);
+}
 
-        }
-    }
-    catch (std::range_error &)
+/// Send the rendered replies that confirm a command.
+void cheapl_service::send_confirmation( const confirmation &reply)
+{
+    get_impl().service.send_rendered( reply.basic);
+    get_impl().service.send_rendered( reply.confirm);
+}
+
+/// Render the replies to the "on" and "off" commands of every device, so that confirming a command
+/// doesn't have to serialize a message.
+void cheapl_service::render_confirmations()
+{
+    for (auto &device : get_impl().lights)
     {
-        // if any of our maps does not contain the entry we're looking for, we
-        // silently ignore this message.
+        for (const auto command : {x10_command::on, x10_command::off})
+        {
+            message reply;
+            reply.message_type = "xpl-trig";
+            reply.headers = {{"hop", "1"}, {"target", "*"}};
+            reply.message_schema = "x10.basic";
+            reply.body = {{"command", x10_command_name( command).to_string()}, {"device", device.first}};
+
+            auto &confirmation = device.second.confirmations[static_cast<std::size_t>( command)];
+            confirmation.basic = std::make_shared<const std::string>( get_impl().service.render( reply));
+            reply.message_schema = "x10.confirm";
+            confirmation.confirm = std::make_shared<const std::string>( get_impl().service.render( reply));
+        }
     }
 }
 
-/// Scan a single directory for wav-files and create a mapping from (device, command) to wav file.
+/// Scan a single directory for wav-files and device settings and create a mapping from (device, command) to waveform.
 /// This function scans all files with extension ".wav" in the given directory. If the name is either
 /// "on<devicename>.wav" or "off<devicename>.wav" then the file will be stored as the file associated with
 /// the "on" or "off" command for the given device. If only one of the two wav-files is present for a given
 /// device name, the device will be ignored.
+/// The wav-files of all remaining devices are loaded into memory, so that they don't have to be read
+/// whenever a command arrives.
+/// Devices for which no recordings are present can instead have a settings file "<devicename>.conf" that
+/// describes the RF protocol and the "on" and "off" codes. Those codes are then synthesized.
+/// The settings file of a device can also select the sound card that the transmitter of the device is
+/// connected to ("card=<card>") and the output channel of the device ("channel=left" or "channel=right"),
+/// which is used in dual transmitter mode, as well as the number of times that every command is played
+/// ("repeat=<n>") and the silence in milliseconds between those repeats ("repeat_gap=<ms>").
 void cheapl_service::scan_files( const std::string& directoryname)
 {
     using dirit = bf::directory_iterator;
     using boost::to_lower_copy;
+    using filemap = std::map< std::string, std::map< std::string, bf::path>>;
 
+    filemap files;
+    std::map< std::string, bf::path> settings_files;
     static const boost::regex onoff_regex{R"(^(on|off)([^.]+)\.wav)", boost::regex::icase};
+    static const boost::regex settings_regex{R"(^([^.]+)\.conf)", boost::regex::icase};
     for (const auto &entry :
             boost::make_iterator_range( dirit(directoryname), dirit()))
     {
@@ -250,22 +588,108 @@ void cheapl_service::scan_files( const std::string& directoryname)
         std::string buffer = entry.path().filename().string();
         if (regex_match( buffer, match, onoff_regex))
         {
-            get_impl().lights[match[2]][to_lower_copy(match[1].str())]
-                                                             = entry.path();
+            files[match[2]][to_lower_copy(match[1].str())] = entry.path();
+        }
+        else if (regex_match( buffer, match, settings_regex))
+        {
+            settings_files[match[1]] = entry.path();
         }
     }
 
-    // now remove all entries for which there are not both an "on" and "off" wave file:
-    auto lights_it = get_impl().lights.begin();
-    while (lights_it != get_impl().lights.end())
+    std::map< std::string, settings_map> settings;
+    for (const auto &device : settings_files)
     {
-        if (lights_it->second.size() != 2)
+        settings[device.first] = read_settings_file( device.second.string());
+    }
+
+    // now load the files of all devices for which there are both an "on" and "off" wave file:
+    for (const auto &device : files)
+    {
+        if (device.second.size() == 2)
         {
-            lights_it = get_impl().lights.erase( lights_it);
+            auto &info = get_impl().lights[device.first];
+            info.output = &get_impl().route( device.first, settings[device.first]);
+            info.repeat_gap = get_impl().repeat_gap;
+            const auto trimmed_before = info.output->waveforms.trimmed_time();
+            for (const auto &command : device.second)
+            {
+                info.commands[static_cast<std::size_t>( find_x10_command( command.first))] =
+                        info.output->waveforms.load( command.second.string());
+            }
+            info.trimmed = info.output->waveforms.trimmed_time() - trimmed_before;
+            if (info.trimmed.count())
+            {
+                std::cout << "device " << device.first << ": cut " << info.trimmed.count() / 1000
+                        << "ms of silence from the recordings\n";
+            }
         }
-        else
+    }
+
+    for (auto &device : settings)
+    {
+        auto &device_settings = device.second;
+
+        // synthesize the codes of devices that have settings, but no recordings.
+        if (!get_impl().lights.count( device.first) && device_settings.count( "on") && device_settings.count( "off"))
         {
-            ++lights_it;
+            const auto protocol = rf_protocol_from_settings( device_settings);
+            auto &info = get_impl().lights[device.first];
+            info.output = &get_impl().route( device.first, device_settings);
+            info.repeat_gap = get_impl().repeat_gap;
+            const unsigned int rate = device_settings.count( "rate") ? std::stoul( device_settings["rate"]) : info.output->rate;
+            for (const auto command : {x10_command::on, x10_command::off})
+            {
+                const auto name = x10_command_name( command).to_string();
+                info.commands[static_cast<std::size_t>( command)] =
+                        info.output->synthesizer.render( protocol, device_settings[name], rate);
+            }
+        }
+
+        const auto info = get_impl().lights.find( device.first);
+        if (info == get_impl().lights.end()) continue;
+
+        if (device_settings.count( "repeat"))
+        {
+            info->second.repeats = repeat_count( device_settings["repeat"]);
+        }
+        if (device_settings.count( "repeat_gap"))
+        {
+            info->second.repeat_gap = std::chrono::milliseconds{ std::stoul( device_settings["repeat_gap"])};
+        }
+        if (device_settings.count( "channel"))
+        {
+            const auto &channel = device_settings["channel"];
+            if (channel != "left" && channel != "right")
+            {
+                throw std::runtime_error( "channel of device " + device.first + " should be either 'left' or 'right'");
+            }
+            info->second.channel = channel == "left" ? 0 : 1;
+        }
+    }
+
+    get_impl().index_devices();
+    render_confirmations();
+    if (get_impl().dual_transmitter) check_dual_transmitter_formats();
+}
+
+/// Check that all waveforms can be played in dual transmitter mode.
+/// In that mode, waveforms are played as one channel of a 16-bit stereo stream, so they must all be 16-bit mono
+/// and have the same sample rate as the other waveforms on the same sound card.
+void cheapl_service::check_dual_transmitter_formats() const
+{
+    std::map< const sound_output *, unsigned int> rates;
+    for (const auto &device : get_impl().lights)
+    {
+        unsigned int &rate = rates[device.second.output];
+        for (const auto command : {x10_command::on, x10_command::off})
+        {
+            const auto &fmt = device.second.commands[static_cast<std::size_t>( command)].fmt;
+            if (fmt.channels != 1 || fmt.bits_per_sample != 16 || (rate && fmt.samplerate != rate))
+            {
+                throw std::runtime_error( "in dual transmitter mode, all waveforms should be 16-bit mono with the same sample rate, "
+                        "but the '" + x10_command_name( command).to_string() + "' waveform of device " + device.first + " isn't");
+            }
+            rate = fmt.samplerate;
         }
     }
 }
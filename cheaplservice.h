@@ -11,29 +11,107 @@
 #include <memory> // for unique_ptr
 #include <string>
 #include <iosfwd>
+#include <cstddef>
+#include <chrono>
+#include <functional>
+#include <vector>
 
 namespace xpl
 {
 
 class message;
+struct message_view;
+struct x10_basic;
+
+/// Determines when the reply to an x10 command is sent.
+enum class acknowledge_mode
+{
+    after_transmission, ///< confirm a command once its waveform has been played completely
+    on_enqueue          ///< confirm a command as soon as its waveform has been queued for playing
+};
+
+/// Which thread writes waveforms to the sound devices.
+enum class playback_mode
+{
+    thread,     ///< every sound device has a playback thread of its own
+    event_loop  ///< the thread that handles the xPL messages also writes to the sound devices, without blocking
+};
+
+/// Tunable settings of a cheapl service.
+struct cheapl_options
+{
+    /// maximum number of bytes of sample data that will be kept in memory for a sound device.
+    std::size_t memory_budget = 32 * 1024 * 1024;
+
+    /// whether to store two-level waveforms in compressed (edge encoded) form.
+    bool compress_waveforms = true;
+
+    /// whether to cut the silence before and after the signal in recordings.
+    bool trim_silence = true;
+
+    /// silence that is kept before and after the signal in trimmed recordings.
+    std::chrono::milliseconds trim_guard{ 10};
+
+    /// maximum number of commands that can wait to be played.
+    std::size_t queue_length = 16;
+
+    /// silence between the waveforms of commands that are transmitted back-to-back.
+    std::chrono::milliseconds inter_code_gap{ 20};
+
+    acknowledge_mode acknowledge = acknowledge_mode::after_transmission;
+
+    /// whether to copy samples directly into the ring buffer of the sound device, if the device supports it.
+    bool use_mmap = true;
+
+    /// whether sound devices start playing after the first period, instead of after filling their buffer.
+    bool fast_start = true;
+
+    /// whether to open sound devices without the alsa plug layer and convert all waveforms to the native
+    /// format of the device when they are loaded.
+    bool native_format = false;
+
+    /// whether the left and right channel of the sound device drive separate transmitters.
+    bool dual_transmitter = false;
+
+    /// sound cards that transmitters are connected to, in addition to the default sound card.
+    std::vector<std::string> additional_cards;
+
+    playback_mode playback = playback_mode::thread;
+};
 
 /// This class acts as an xPL service. It listens on an UDP port for xPL messages and when messages of the right type (x10 schema commands)
 /// arrive, a corresponding wav-file will be played on the given soundcard device. The soundcard is supposed to be connected to an RF-transmitter.
+/// Additional sound cards, each with their own transmitter, can be configured. Every sound card plays on its own thread,
+/// unless the service is configured to write to the sound cards from the same thread that handles the network.
 /// This service will only run while the run() member function is being executed.
+/// While running, the service writes a report with playback statistics to stdout whenever it receives SIGUSR1.
 /// This class an object of type xpl::application_service class for all its xpl communication and uses the alsa_wrapper functions
 /// to play "sounds".
 class cheapl_service
 {
 public:
-    cheapl_service( const std::string &directoryname, const std::string &soundcardname, const std::string &application_id, const std::string &application_version = "1.0");
+    cheapl_service( const std::string &directoryname, const std::string &soundcardname, const std::string &application_id, const std::string &application_version = "1.0",
+            const cheapl_options &options = cheapl_options{});
     ~cheapl_service();
     void run();
     static void list_cards( std::ostream& output);
+    static void tune_cards( const std::string &directoryname, const std::string &soundcardname,
+            const cheapl_options &options, std::ostream& output);
     void signoff();
+    void report( std::ostream& output) const;
 
 private:
+    struct confirmation;
+
+    void handle_command( const message_view &view);
     void handle_command( const message &m);
+    void queue_command( const x10_basic &command, bool bare, std::chrono::steady_clock::time_point received,
+            std::chrono::steady_clock::time_point parsed, const std::function<message ()> &make_message);
+    void send_confirmation( const message &m);
+    void send_confirmation( const confirmation &reply);
+    void render_confirmations();
     void scan_files( const std::string &directoryname);
+    void check_dual_transmitter_formats() const;
 
     struct impl;
     std::unique_ptr<impl> pimpl;
@@ -10,9 +10,258 @@
 #include <boost/regex.hpp> // I'm having trouble with std::regex and brackets ("[" and "]").
 #include "datagramparser.h"
 
+#include <algorithm>
+#include <ostream>
+
 namespace xpl
 {
 
+namespace {
+
+void append_field( const std::string &name, const std::string &value, std::string &output)
+{
+    output.append( name).append( 1, '=').append( value).append( 1, '\n');
+}
+
+/// Append the name=value pairs of a message header or body, surrounded by braces. The names in 'order'
+/// come first, in that order, all other names follow in alphabetical order.
+void append_map( const message::map &map, const key_order &order, std::string &output)
+{
+    output.append( "{\n");
+    for (const auto &name : order)
+    {
+        const auto field = map.find( name);
+        if (field != map.end()) append_field( field->first, field->second, output);
+    }
+    for (const auto &field : map)
+    {
+        if (std::find( order.begin(), order.end(), field.first) == order.end())
+        {
+            append_field( field.first, field.second, output);
+        }
+    }
+    output.append( "}\n");
+}
+}
+
+/// Write the name=value pairs of a message header or body, surrounded by braces.
+void map_to_stream( const message::map &map, std::ostream &stream)
+{
+    stream << "{\n";
+    for (const auto &header_value : map)
+    {
+        stream << header_value.first << '=' << header_value.second << '\n';
+    }
+    stream << "}\n";
+}
+
+/// convert an xpl-message to a string that can be sent as an
+/// UDP packet.
+std::string to_string( const message &m)
+{
+    std::string result;
+    serialize( m, result);
+    return result;
+}
+
+/// Append the text of an xpl-message to 'output', with the fields of the body in the given order.
+/// Header fields are written in alphabetical order, which for the standard header fields hop, source and
+/// target is also the order that xpl prescribes. Callers that reuse the same output string for every
+/// message only allocate memory when a message is longer than any message before it.
+void serialize( const message &m, std::string &output, const key_order &body_order)
+{
+    output.append( m.message_type).append( 1, '\n');
+    append_map( m.headers, key_order{}, output);
+    output.append( m.message_schema).append( 1, '\n');
+    append_map( m.body, body_order, output);
+}
+
+namespace {
+
+/// whether a character is white space, in the sense of std::isspace() in the "C" locale.
+bool is_space( char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+/// Split a line into a name and a value, in the same way as the regular expression ^([^= ]+)\s*=\s*(.*)$
+/// that the datagram_parser uses. Returns false if the line is not a name=value pair.
+bool split_name_value( const char *begin, const char *end, message_view::field &result)
+{
+    const char *name_end = begin;
+    while (name_end != end && *name_end != '=' && *name_end != ' ') ++name_end;
+    if (name_end == begin) return false;
+
+    const char *equals = name_end;
+    while (equals != end && is_space( *equals)) ++equals;
+    if (equals == end || *equals != '=') return false;
+
+    const char *value = equals + 1;
+    while (value != end && is_space( *value)) ++value;
+
+    result.name = message_view::string_view( begin, name_end - begin);
+    result.value = message_view::string_view( value, end - value);
+    return true;
+}
+
+/// Find the next line in the text between 'position' and 'end' that isn't empty and return it, without the
+/// white space around it, in 'text'. 'position' is moved past the end of the line.
+/// Returns false if there are no more lines.
+bool next_line( const char *&position, const char *end, message_view::string_view &text)
+{
+    for (;;)
+    {
+        if (position == end) return false;
+        const char *line = position;
+        const char *line_end = line;
+        while (line_end != end && *line_end != '\n') ++line_end;
+        position = line_end == end ? end : line_end + 1;
+        if (line_end == line) continue;
+
+        while (line != line_end && is_space( *line)) ++line;
+        while (line_end != line && is_space( *(line_end - 1))) --line_end;
+        text = message_view::string_view( line, line_end - line);
+        return true;
+    }
+}
+
+/// Add the name=value pair on a line to the fields of a view. Lines that aren't name=value pairs are ignored.
+/// Returns false if the view is full.
+bool add_field( message_view::string_view text, message_view &result)
+{
+    message_view::field field;
+    if (!split_name_value( text.data(), text.data() + text.size(), field)) return true;
+    if (result.field_count == message_view::capacity)
+    {
+        result.overflow = true;
+        return false;
+    }
+    result.fields[result.field_count++] = field;
+    return true;
+}
+}
+
+/// Create a message that holds copies of all parts of this view.
+message message_view::to_message() const
+{
+    message result;
+    result.received = received;
+    result.parsed = parsed;
+    result.message_type.assign( message_type.data(), message_type.size());
+    result.message_schema.assign( message_schema.data(), message_schema.size());
+    for (std::size_t index = 0; index < field_count; ++index)
+    {
+        auto &map = index < header_count ? result.headers : result.body;
+        map[std::string( fields[index].name.data(), fields[index].name.size())]
+            .assign( fields[index].value.data(), fields[index].value.size());
+    }
+    return result;
+}
+
+/// Make a view that refers to the text of a message, for code that handles message views.
+/// The view is only valid for as long as the message is unchanged.
+/// Returns false, with 'overflow' set in the result, if the message has more fields than a view can hold.
+bool view_message( const message &m, message_view &result)
+{
+    result = message_view{};
+    result.message_type = m.message_type;
+    result.message_schema = m.message_schema;
+    result.received = m.received;
+    result.parsed = m.parsed;
+    if (m.headers.size() + m.body.size() > message_view::capacity)
+    {
+        result.overflow = true;
+        return false;
+    }
+    for (const auto &field : m.headers)
+    {
+        result.fields[result.field_count++] = { field.first, field.second};
+    }
+    result.header_count = result.field_count;
+    for (const auto &field : m.body)
+    {
+        result.fields[result.field_count++] = { field.first, field.second};
+    }
+    return true;
+}
+
+/// Return the last field of the header with the given name, or nullptr if the header doesn't have it.
+const message_view::field *message_view::find_header( string_view name) const
+{
+    for (std::size_t index = header_count; index != 0; --index)
+    {
+        if (fields[index - 1].name == name) return &fields[index - 1];
+    }
+    return nullptr;
+}
+
+/// Parse the datagram of 'size' bytes at 'data' into a view of the message that it contains.
+/// The datagram is walked once, without copying any text and without allocating memory. The result is the
+/// same as when the lines of the datagram are fed to a datagram_parser: empty lines are skipped,
+/// every line is trimmed and lines that follow the message are ignored.
+/// Returns true if the datagram contains a complete message. If it contains more fields than a view can
+/// hold, false is returned and 'overflow' is set in the result.
+bool parse_datagram( const char *data, std::size_t size, message_view &result)
+{
+    return parse_header( data, size, result) && parse_body( result);
+}
+
+/// Parse the first part of a datagram: the message type, the header and the message schema.
+/// Returns true if that part is complete, after which parse_body() can parse the rest of the datagram.
+/// Deciding whether a message is of interest seldom needs more than this, so that datagrams that aren't
+/// can be dropped without looking at their body.
+bool parse_header( const char *data, std::size_t size, message_view &result)
+{
+    enum {
+        expect_message_type,
+        expect_header,
+        expect_message_schema
+    } state = expect_message_type;
+
+    result.message_type.clear();
+    result.message_schema.clear();
+    result.header_count = 0;
+    result.field_count = 0;
+    result.overflow = false;
+    result.end = data + size;
+    result.position = data;
+
+    message_view::string_view text;
+    while (next_line( result.position, result.end, text))
+    {
+        switch (state)
+        {
+        case expect_message_type:
+            if (text == "{") state = expect_header;
+            else result.message_type = text;
+            break;
+        case expect_header:
+            if (text == "}") state = expect_message_schema;
+            else if (!add_field( text, result)) return false;
+            result.header_count = result.field_count;
+            break;
+        case expect_message_schema:
+            if (text == "{") return true;
+            result.message_schema = text;
+            break;
+        }
+    }
+    return false;
+}
+
+/// Parse the body of a datagram of which parse_header() has parsed the first part.
+/// Returns true if the datagram contains a complete message.
+bool parse_body( message_view &result)
+{
+    message_view::string_view text;
+    while (next_line( result.position, result.end, text))
+    {
+        if (text == "}") return true;
+        if (!add_field( text, result)) return false;
+    }
+    return false;
+}
+
 void datagram_parser::feed_line( std::string line)
 {
     //static const std::string r(R"((.+)=(.+))");
@@ -8,8 +8,14 @@
 
 #ifndef DATAGRAMPARSER_H_
 #define DATAGRAMPARSER_H_
+#include <boost/utility/string_view.hpp>
+#include <array>
 #include <string>
 #include <map>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
 
 namespace xpl
 {
@@ -19,12 +25,65 @@ struct message
     using string = std::string;
     using map = std::map<string, string>;
 
+    using time_point = std::chrono::steady_clock::time_point;
+
     string  message_type;
     string  message_schema;
     map     headers;
     map     body;
+
+    time_point received;   ///< when the datagram of a received message arrived
+    time_point parsed;     ///< when the datagram of a received message was parsed
 };
 
+/// names of the body fields of a schema, in the order in which they should be written.
+using key_order = std::vector<std::string>;
+
+void map_to_stream( const message::map &map, std::ostream &stream);
+std::string to_string( const message &m);
+void serialize( const message &m, std::string &output, const key_order &body_order = key_order{});
+
+/// An xpl message that refers to the text of the datagram that it was parsed from, instead of holding
+/// copies of it. The fields of the header and body are kept in the order in which they appear in the
+/// datagram, so a name that appears more than once in a header or body has its last value there.
+/// A view is only valid for as long as the datagram text is.
+struct message_view
+{
+    using string_view = boost::string_view;
+
+    struct field
+    {
+        string_view name;
+        string_view value;
+    };
+
+    /// maximum number of header and body fields together.
+    static const std::size_t capacity = 32;
+
+    string_view message_type;
+    string_view message_schema;
+    std::array<field, capacity> fields;   ///< the header fields, followed by the body fields
+    std::size_t header_count = 0;         ///< number of fields that belong to the header
+    std::size_t field_count = 0;          ///< number of fields in total
+    bool        overflow = false;         ///< whether the datagram had more fields than a view can hold
+    const char  *position = nullptr;      ///< where parsing of the datagram continues
+    const char  *end = nullptr;           ///< end of the text of the datagram
+
+    message::time_point received;   ///< when the datagram of a received message arrived
+    message::time_point parsed;     ///< when the datagram of a received message was parsed
+
+    const field *find_header( string_view name) const;
+    message to_message() const;
+};
+
+bool parse_datagram( const char *data, std::size_t size, message_view &result);
+bool parse_header( const char *data, std::size_t size, message_view &result);
+bool parse_body( message_view &result);
+bool view_message( const message &m, message_view &result);
+
+/// Parser that is fed a datagram one line at a time and builds a message out of it.
+/// parse_datagram() produces exactly the same messages without copying the text, this parser is
+/// used for datagrams with more fields than a message_view can hold.
 class datagram_parser
 {
 public:
@@ -0,0 +1,259 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "edge_encoding.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+using level = edge_encoding::level;
+
+/// Samples above 'upper' are high, samples below 'lower' are low and everything in between is idle.
+struct thresholds
+{
+    std::int16_t lower;
+    std::int16_t upper;
+};
+
+level classify( std::int16_t sample, const thresholds &t)
+{
+    return sample > t.upper ? edge_encoding::high : (sample < t.lower ? edge_encoding::low : edge_encoding::idle);
+}
+
+/// Return the position of the first sample at or after 'position' that does not have level 'current'.
+/// With SSE2, this function compares eight samples at a time against both thresholds and only falls
+/// back to inspecting single samples in the block that contains the change.
+std::size_t find_level_change(
+        const std::int16_t *samples, std::size_t position, std::size_t count,
+        level current, const thresholds &t)
+{
+#if defined(__SSE2__)
+    const __m128i upper = _mm_set1_epi16( t.upper);
+    const __m128i lower = _mm_set1_epi16( t.lower);
+    const int expected_above = current == edge_encoding::high ? 0xffff : 0;
+    const int expected_below = current == edge_encoding::low ? 0xffff : 0;
+    while (position + 8 <= count)
+    {
+        const __m128i block = _mm_loadu_si128( reinterpret_cast<const __m128i *>( samples + position));
+        const int above = _mm_movemask_epi8( _mm_cmpgt_epi16( block, upper));
+        const int below = _mm_movemask_epi8( _mm_cmplt_epi16( block, lower));
+        if (above != expected_above || below != expected_below) break;
+        position += 8;
+    }
+#endif
+    while (position < count && classify( samples[position], t) == current) ++position;
+    return position;
+}
+
+/// returns the level that follows 'previous' if the level change bit of a run has the given value.
+level next_level( level previous, unsigned int change)
+{
+    return static_cast<level>( (previous + 1 + change) % 3);
+}
+
+/// Append a number to 'output' in 7 bit groups, lowest group first, with the top bit of every byte set
+/// if more bytes follow.
+void append_varint( std::vector<std::uint8_t> &output, std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        output.push_back( static_cast<std::uint8_t>( value | 0x80));
+        value >>= 7;
+    }
+    output.push_back( static_cast<std::uint8_t>( value));
+}
+
+/// Reads the runs of an edge encoding one by one, starting at a checkpoint.
+class run_reader
+{
+public:
+    run_reader( const edge_encoding &encoding, const edge_encoding::checkpoint &start)
+    :position{ encoding.runs.data() + start.offset},
+     last{ encoding.runs.data() + encoding.runs.size()},
+     run_end{ start.frame},
+     current{ start.current}
+    {
+    }
+
+    /// Read the next run, the first call reads the run that the checkpoint points at.
+    /// Returns false if there are no more runs.
+    bool next()
+    {
+        if (position == last) return false;
+
+        std::uint64_t value = 0;
+        unsigned int shift = 0;
+        std::uint8_t byte;
+        do
+        {
+            byte = *position++;
+            value |= static_cast<std::uint64_t>( byte & 0x7f) << shift;
+            shift += 7;
+        } while ((byte & 0x80) && position != last);
+
+        if (!first) current = next_level( current, value & 1);
+        first = false;
+        run_begin = run_end;
+        run_end += value >> 1;
+        return true;
+    }
+
+    std::size_t begin() const { return run_begin;}  ///< first frame of the current run
+    std::size_t end() const { return run_end;}      ///< frame just past the current run
+    level       level_of_run() const { return current;}
+
+private:
+    const std::uint8_t  *position;
+    const std::uint8_t  *last;
+    std::size_t         run_begin = 0;
+    std::size_t         run_end;
+    level               current;
+    bool                first = true;
+};
+}
+
+/// Fill a run of samples with a single value.
+/// This is written as a plain counted loop over contiguous memory, which compilers turn into vector stores.
+void fill_samples( std::int16_t *begin, std::size_t count, std::int16_t value)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        begin[i] = value;
+    }
+}
+
+/// Write 'count' samples of the waveform, starting at 'first_frame', to 'destination'.
+/// Decoding starts at the last checkpoint before 'first_frame', so that at most a checkpoint interval of
+/// runs needs to be skipped.
+void edge_encoding::expand( std::int16_t *destination, std::size_t first_frame, std::size_t count) const
+{
+    const std::size_t end = std::min( first_frame + count, frame_count);
+    if (first_frame >= end) return;
+
+    const auto start = std::upper_bound( checkpoints.begin(), checkpoints.end(), first_frame,
+            []( std::size_t frame, const checkpoint &c) { return frame < c.frame;}) - 1;
+    run_reader run{ *this, *start};
+    run.next();
+    while (run.end() <= first_frame) run.next();
+
+    std::size_t position = first_frame;
+    for (;;)
+    {
+        const std::size_t run_end = std::min( run.end(), end);
+        fill_samples( destination, run_end - position, values[run.level_of_run()]);
+        destination += run_end - position;
+        position = run_end;
+        if (position == end) break;
+        run.next();
+    }
+}
+
+/// Create an edge encoding of the given 16-bit mono samples.
+/// The thresholds between the levels are placed halfway between the middle and the extremes of the signal,
+/// so that noise around the idle level and around the high and low levels does not cause spurious edges.
+/// Returns a null pointer if there are no samples or if the samples are too long to be encoded.
+std::shared_ptr<edge_encoding> edge_encode( const std::int16_t *samples, std::size_t count)
+{
+    static const std::size_t max_position = std::numeric_limits<std::uint32_t>::max();
+    if (!count || count > max_position) return nullptr;
+
+    const auto extremes = std::minmax_element( samples, samples + count);
+    const int minimum = *extremes.first;
+    const int maximum = *extremes.second;
+    const int middle = (minimum + maximum) / 2;
+    const thresholds t{
+        static_cast<std::int16_t>( middle - (maximum - minimum) / 4),
+        static_cast<std::int16_t>( middle + (maximum - minimum) / 4)};
+
+    auto result = std::make_shared<edge_encoding>();
+    result->frame_count = count;
+    result->values[edge_encoding::low]  = static_cast<std::int16_t>( minimum);
+    result->values[edge_encoding::idle] = static_cast<std::int16_t>( middle);
+    result->values[edge_encoding::high] = static_cast<std::int16_t>( maximum);
+
+    std::size_t position = 0;
+    std::size_t run_count = 0;
+    level previous = edge_encoding::idle;
+    while (position < count)
+    {
+        const auto current = classify( samples[position], t);
+        const auto end = find_level_change( samples, position + 1, count, current, t);
+        if (run_count % edge_encoding::checkpoint_interval == 0)
+        {
+            if (result->runs.size() > max_position) return nullptr;
+            result->checkpoints.push_back( {
+                static_cast<std::uint32_t>( position), static_cast<std::uint32_t>( result->runs.size()), current});
+        }
+
+        // consecutive runs always have different levels, so one bit tells which of the two others it is.
+        const unsigned int change = run_count ? (current - previous + 2) % 3 : 0;
+        append_varint( result->runs, static_cast<std::uint64_t>( end - position) << 1 | change);
+        previous = current;
+        position = end;
+        ++run_count;
+    }
+
+    result->runs.shrink_to_fit();
+    result->checkpoints.shrink_to_fit();
+    return result;
+}
+
+/// Expand an encoding again and check that it reproduces the original samples.
+/// Every expanded sample is compared with the original one. Except for the samples right next to an edge,
+/// where a recorded signal makes its transition from one level to the next, no sample may deviate from its
+/// expanded value by more than an eighth of the distance between the lowest and highest level. Signals
+/// that aren't made of flat levels, like slow tones, levels that droop or noisy recordings, fail this check.
+bool verify_edge_encoding( const edge_encoding &encoding, const std::int16_t *samples, std::size_t count)
+{
+    // maximum deviation of a sample, as a fraction 1/n of the distance between the lowest and highest level.
+    static const int deviation_divisor = 8;
+    // number of samples on either side of an edge that may deviate more, because they are part of the transition.
+    static const std::size_t edge_width = 2;
+
+    if (encoding.frame_count != count || encoding.checkpoints.empty() || encoding.checkpoints.front().frame != 0)
+    {
+        return false;
+    }
+
+    // the runs must exactly cover the samples, before any of them can be expanded.
+    run_reader all_runs{ encoding, encoding.checkpoints.front()};
+    while (all_runs.next()) {}
+    if (all_runs.end() != count) return false;
+
+    const int range = encoding.values[edge_encoding::high] - encoding.values[edge_encoding::low];
+    const int allowed = range / deviation_divisor;
+
+    const std::size_t block_size = 4096;
+    std::int16_t expanded[block_size];
+    run_reader run{ encoding, encoding.checkpoints.front()};
+    run.next();
+    for (std::size_t position = 0; position < count; position += block_size)
+    {
+        const auto block = std::min( block_size, count - position);
+        encoding.expand( expanded, position, block);
+        for (std::size_t i = 0; i < block; ++i)
+        {
+            const std::size_t frame = position + i;
+            while (run.end() <= frame) run.next();
+
+            if (std::abs( expanded[i] - samples[frame]) <= allowed) continue;
+
+            const bool after_edge = run.begin() != 0 && frame - run.begin() < edge_width;
+            const bool before_edge = run.end() != count && run.end() - frame <= edge_width;
+            if (!after_edge && !before_edge) return false;
+        }
+    }
+    return true;
+}
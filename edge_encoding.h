@@ -0,0 +1,56 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef EDGE_ENCODING_H_
+#define EDGE_ENCODING_H_
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// Compact representation of a 16-bit mono waveform that consists of (nearly) constant levels, like the
+/// square waves that drive an RF transmitter.
+/// Every sample is classified as either low, idle or high and only the lengths of the runs of samples with
+/// the same class are stored. Each run takes a variable number of bytes, 7 bits per byte, with the lowest bit
+/// of the first byte telling which of the two other levels the run has. Runs of less than 64 frames, like the
+/// pulses of 433MHz remote controls at common sample rates, take a single byte and runs of less than 8192
+/// frames take two. To start expanding in the middle of the waveform, the position of every 128th run is
+/// kept in an index. Expanding the encoding produces one fixed sample value per class.
+struct edge_encoding
+{
+    enum level : std::uint8_t { low, idle, high};
+
+    /// start of a run in the encoding, both in frames and in bytes.
+    struct checkpoint
+    {
+        std::uint32_t   frame;
+        std::uint32_t   offset;     ///< position of the first byte of the run in 'runs'
+        level           current;    ///< level of the run, for the first checkpoint this is the only place it is stored
+    };
+
+    /// number of runs between checkpoints.
+    static const std::size_t checkpoint_interval = 128;
+
+    std::size_t                 frame_count = 0;
+    std::int16_t                values[3] = {};     ///< sample value of each level
+    std::vector<std::uint8_t>   runs;               ///< run lengths and level changes, as described above
+    std::vector<checkpoint>     checkpoints;        ///< start of run 0, 128, 256, ...
+
+    std::size_t memory_size() const
+    {
+        return sizeof *this + runs.size() + checkpoints.size() * sizeof checkpoints[0];
+    }
+
+    void expand( std::int16_t *destination, std::size_t first_frame, std::size_t count) const;
+};
+
+void fill_samples( std::int16_t *begin, std::size_t count, std::int16_t value);
+std::shared_ptr<edge_encoding> edge_encode( const std::int16_t *samples, std::size_t count);
+bool verify_edge_encoding( const edge_encoding &encoding, const std::int16_t *samples, std::size_t count);
+
+#endif /* EDGE_ENCODING_H_ */
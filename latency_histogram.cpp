@@ -0,0 +1,132 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <utility>
+
+namespace {
+
+/// position of the most significant bit that is set in a non-zero value.
+unsigned int most_significant_bit( std::uint64_t value)
+{
+    unsigned int result = 0;
+    while (value >>= 1) ++result;
+    return result;
+}
+}
+
+/// Return the bucket that counts the given value.
+/// Values below 'sub_buckets' have a bucket of their own. Larger values are grouped by their most
+/// significant bit and then by the next 'sub_bucket_bits' bits.
+std::size_t latency_histogram::bucket_index( std::uint64_t value)
+{
+    if (value < sub_buckets) return value;
+    const unsigned int msb = most_significant_bit( value);
+    const unsigned int shift = msb - sub_bucket_bits;
+    return (msb - sub_bucket_bits + 1) * sub_buckets + ((value >> shift) & (sub_buckets - 1));
+}
+
+/// Return the largest value that is counted by the given bucket.
+std::uint64_t latency_histogram::bucket_upper_bound( std::size_t index)
+{
+    if (index < sub_buckets) return index;
+    const unsigned int shift = index / sub_buckets - 1;
+    const std::uint64_t lower = (sub_buckets + index % sub_buckets) << shift;
+    return lower + ((std::uint64_t{1} << shift) - 1);
+}
+
+/// Count a single duration.
+void latency_histogram::record( duration d)
+{
+    const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>( d).count();
+    const std::uint64_t value = microseconds > 0 ? microseconds : 0;
+    buckets[bucket_index( value)].fetch_add( 1, std::memory_order_relaxed);
+
+    auto current = max_value.load( std::memory_order_relaxed);
+    while (value > current && !max_value.compare_exchange_weak( current, value, std::memory_order_relaxed))
+    {
+        // current was reloaded by compare_exchange_weak(), try again.
+    }
+}
+
+/// Total number of durations that were recorded.
+std::uint64_t latency_histogram::count() const
+{
+    std::uint64_t result = 0;
+    for (const auto &bucket : buckets)
+    {
+        result += bucket.load( std::memory_order_relaxed);
+    }
+    return result;
+}
+
+/// Return the duration in microseconds that the given fraction (0-1) of all recorded durations does not exceed.
+/// The result is the upper bound of the bucket that holds the percentile, so it overestimates by at most
+/// the width of that bucket.
+std::uint64_t latency_histogram::percentile( double p) const
+{
+    const auto total = count();
+    if (!total) return 0;
+
+    std::uint64_t wanted = static_cast<std::uint64_t>( p * total + 0.5);
+    if (wanted < 1) wanted = 1;
+
+    std::uint64_t seen = 0;
+    for (std::size_t index = 0; index < bucket_count; ++index)
+    {
+        seen += buckets[index].load( std::memory_order_relaxed);
+        if (seen >= wanted) return std::min( bucket_upper_bound( index), maximum());
+    }
+    return maximum();
+}
+
+/// Add the stages of a single command to the histograms.
+/// Commands that never reached the sound device only count towards the stages that they did pass.
+void latency_statistics::record( const latency_trace &trace)
+{
+    const latency_trace::time_point never{};
+    if (trace.received == never) return;
+
+    if (trace.parsed != never)
+    {
+        parse.record( trace.parsed - trace.received);
+        if (trace.dispatched != never) dispatch.record( trace.dispatched - trace.parsed);
+    }
+    if (trace.dispatched != never && trace.first_write != never)
+    {
+        queue.record( trace.first_write - trace.dispatched);
+        if (trace.completed != never) transmit.record( trace.completed - trace.first_write);
+    }
+    if (trace.completed != never) total.record( trace.completed - trace.received);
+}
+
+/// Write a summary of every stage to the given output stream. All durations are in microseconds.
+void latency_statistics::report( std::ostream &output) const
+{
+    const std::pair<const char *, const latency_histogram *> stages[] = {
+            {"parse", &parse}, {"dispatch", &dispatch}, {"queue", &queue},
+            {"transmit", &transmit}, {"total", &total}};
+
+    output << std::left << std::setw( 12) << "latency (us)" << std::right
+            << std::setw( 9) << "count" << std::setw( 9) << "p50" << std::setw( 9) << "p90"
+            << std::setw( 9) << "p99" << std::setw( 9) << "max" << '\n';
+    for (const auto &stage : stages)
+    {
+        const auto &histogram = *stage.second;
+        output << std::left << std::setw( 12) << stage.first << std::right
+                << std::setw( 9) << histogram.count()
+                << std::setw( 9) << histogram.percentile( 0.50)
+                << std::setw( 9) << histogram.percentile( 0.90)
+                << std::setw( 9) << histogram.percentile( 0.99)
+                << std::setw( 9) << histogram.maximum() << '\n';
+    }
+}
@@ -0,0 +1,74 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+/// Histogram of durations with a bounded relative error, in the style of an HDR histogram.
+/// Durations are counted in microseconds. Every power of two is divided into a fixed number of linear
+/// sub-buckets, so that every recorded value is known to within 1/sub_buckets of its size, from a
+/// microsecond up to hours.
+/// Recording is lock-free and wait-free, so that it can be done from any thread, including the playback
+/// threads, while another thread reads the histogram.
+class latency_histogram
+{
+public:
+    using duration = std::chrono::steady_clock::duration;
+
+    void record( duration d);
+
+    std::uint64_t count() const;
+    std::uint64_t percentile( double p) const;
+    std::uint64_t maximum() const { return max_value.load( std::memory_order_relaxed);}
+
+private:
+    static const unsigned int sub_bucket_bits = 3;
+    static const unsigned int sub_buckets = 1 << sub_bucket_bits;
+    static const unsigned int bucket_count = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+    static std::size_t bucket_index( std::uint64_t value);
+    static std::uint64_t bucket_upper_bound( std::size_t index);
+
+    std::atomic<std::uint64_t> buckets[bucket_count] = {};
+    std::atomic<std::uint64_t> max_value{ 0};
+};
+
+/// Points in time that a single command passes on its way from the network to the RF transmitter.
+struct latency_trace
+{
+    using time_point = std::chrono::steady_clock::time_point;
+
+    time_point received;    ///< datagram was received from the socket
+    time_point parsed;      ///< datagram was parsed into a message
+    time_point dispatched;  ///< waveform was handed to the playback queue
+    time_point first_write; ///< first frames of the waveform were written to the sound device
+    time_point completed;   ///< sound device was drained after the waveform
+};
+
+/// Latency histograms for every stage that a command goes through.
+class latency_statistics
+{
+public:
+    void record( const latency_trace &trace);
+    void report( std::ostream &output) const;
+
+private:
+    latency_histogram parse;      ///< from receive to parse complete
+    latency_histogram dispatch;   ///< from parse complete to queued for playback
+    latency_histogram queue;      ///< from queued for playback to first write to the device
+    latency_histogram transmit;   ///< from first write to drain complete
+    latency_histogram total;      ///< from receive to drain complete
+};
+
+#endif /* LATENCY_HISTOGRAM_H_ */
@@ -0,0 +1,203 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "pcm_tuner.h"
+#include "settings_file.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+/// number of times that every candidate is played, to even out coincidences.
+const unsigned int repetitions = 3;
+
+/// length of the test signal in seconds.
+const unsigned int signal_length = 1;
+
+/// Give up on a device that hasn't started playing after this long.
+const std::chrono::seconds start_timeout{ 1};
+
+/// CPU time in seconds that this process has used so far.
+double cpu_time()
+{
+    rusage usage;
+    getrusage( RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/// Create a square wave like the ones that drive the transmitter, of 'frames' 16-bit mono frames.
+std::vector<std::int16_t> test_signal( std::size_t frames)
+{
+    std::vector<std::int16_t> result( frames);
+    for (std::size_t frame = 0; frame < frames; ++frame)
+    {
+        result[frame] = (frame / 17) % 2 ? 32767 : -32767;
+    }
+    return result;
+}
+
+/// Play the test signal once, in the way that the playback thread writes waveforms.
+/// The start latency is measured from the first write until the device reports that the first frame left
+/// the ring buffer. After that, the rest of the signal is written one period at a time.
+pcm_tuning_result play_test_signal( opened_pcm_device &device, const std::vector<std::int16_t> &signal, unsigned int rate)
+{
+    pcm_tuning_result result{ device.get_buffering(), true, 0, 0, 0};
+    device.configure( { SND_PCM_FORMAT_S16_LE, rate, 1, 0, 0});
+    const auto underruns = device.statistics().underruns;
+    const auto data = reinterpret_cast<const char *>( signal.data());
+
+    const auto start = clock_type::now();
+    const snd_pcm_uframes_t first = std::min<snd_pcm_uframes_t>( device.start_threshold(), signal.size());
+    device.write( data, first);
+    while (device.delay() >= static_cast<snd_pcm_sframes_t>( first))
+    {
+        if (clock_type::now() - start > start_timeout) throw std::runtime_error( "device did not start");
+        std::this_thread::sleep_for( std::chrono::microseconds( 50));
+    }
+    result.start_latency = std::chrono::duration<double, std::milli>( clock_type::now() - start).count();
+
+    const double cpu_start = cpu_time();
+    const auto stream_start = clock_type::now();
+    const snd_pcm_uframes_t period = device.period_size().first;
+    for (snd_pcm_uframes_t offset = first; offset < signal.size(); offset += period)
+    {
+        device.write( data + offset * sizeof signal[0], std::min<snd_pcm_uframes_t>( period, signal.size() - offset));
+    }
+    const std::chrono::duration<double> elapsed = clock_type::now() - stream_start;
+    result.cpu_load = elapsed.count() > 0 ? (cpu_time() - cpu_start) / elapsed.count() : 0;
+
+    device.drain();
+    device.prepare();
+    result.underruns = device.statistics().underruns - underruns;
+    return result;
+}
+
+/// Ordering of results from best to worst: fewest underruns first, then shortest start latency, then lowest cpu load.
+bool better( const pcm_tuning_result &left, const pcm_tuning_result &right)
+{
+    if (left.supported != right.supported) return left.supported;
+    return std::make_tuple( left.underruns, left.start_latency, left.cpu_load)
+            < std::make_tuple( right.underruns, right.start_latency, right.cpu_load);
+}
+}
+
+/// Play a test signal with every candidate buffering and measure how well the device copes with it.
+/// Every candidate is played a number of times. The reported start latency and cpu load are the worst
+/// of all repetitions and the underruns are summed over all repetitions.
+/// The device is left with its original buffering.
+std::vector<pcm_tuning_result> measure_buffering(
+        opened_pcm_device &device, const std::vector<pcm_buffering> &candidates, unsigned int rate)
+{
+    const auto original = device.get_buffering();
+    const auto signal = test_signal( signal_length * rate);
+
+    std::vector<pcm_tuning_result> results;
+    for (const auto &candidate : candidates)
+    {
+        pcm_tuning_result result{ candidate, true, 0, 0, 0};
+        try
+        {
+            device.set_buffering( candidate);
+            for (unsigned int repetition = 0; repetition < repetitions; ++repetition)
+            {
+                const auto measured = play_test_signal( device, signal, rate);
+                result.start_latency = std::max( result.start_latency, measured.start_latency);
+                result.cpu_load = std::max( result.cpu_load, measured.cpu_load);
+                result.underruns += measured.underruns;
+            }
+        }
+        catch (std::exception &)
+        {
+            result.supported = false;
+            try
+            {
+                device.drain();
+                device.prepare();
+            }
+            catch (std::exception &)
+            {
+                // the device may not even have been configured.
+            }
+        }
+        results.push_back( result);
+    }
+
+    device.set_buffering( original);
+    return results;
+}
+
+/// Try a range of period and buffer sizes on the device and return the best one.
+/// A table of all measurements is written to 'report'.
+pcm_buffering tune_buffering( opened_pcm_device &device, unsigned int rate, std::ostream &report)
+{
+    std::vector<pcm_buffering> candidates;
+    for (snd_pcm_uframes_t period : {32, 64, 128, 256, 512, 1024})
+    {
+        for (snd_pcm_uframes_t periods : {2, 4, 8})
+        {
+            candidates.push_back( { period, period * periods});
+        }
+    }
+
+    auto results = measure_buffering( device, candidates, rate);
+
+    report << std::setw( 8) << "period" << std::setw( 8) << "buffer" << std::setw( 14) << "latency (ms)"
+            << std::setw( 11) << "underruns" << std::setw( 8) << "cpu %" << '\n';
+    for (const auto &result : results)
+    {
+        report << std::setw( 8) << result.buffering.period_size << std::setw( 8) << result.buffering.buffer_size;
+        if (result.supported)
+        {
+            report << std::fixed << std::setprecision( 2)
+                    << std::setw( 14) << result.start_latency << std::setw( 11) << result.underruns
+                    << std::setw( 8) << result.cpu_load * 100 << '\n';
+        }
+        else
+        {
+            report << "  not supported\n";
+        }
+    }
+
+    const auto best = std::min_element( results.begin(), results.end(), better);
+    if (best == results.end() || !best->supported)
+    {
+        throw std::runtime_error( "the sound device does not support any of the tried period and buffer sizes");
+    }
+    return best->buffering;
+}
+
+/// Read the period and buffer size that were stored by write_buffering().
+pcm_buffering read_buffering( const std::string &filename)
+{
+    auto settings = read_settings_file( filename);
+    if (!settings.count( "period_size") || !settings.count( "buffer_size"))
+    {
+        throw std::runtime_error( filename + " should contain a period_size and a buffer_size");
+    }
+    return { std::stoul( settings["period_size"]), std::stoul( settings["buffer_size"])};
+}
+
+/// Store a period and buffer size in a settings file.
+void write_buffering( const std::string &filename, const pcm_buffering &buffering)
+{
+    write_settings_file( filename, {
+            {"period_size", std::to_string( buffering.period_size)},
+            {"buffer_size", std::to_string( buffering.buffer_size)}});
+}
@@ -0,0 +1,34 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef PCM_TUNER_H_
+#define PCM_TUNER_H_
+#include "alsa_wrapper.hpp"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/// Measurements of a test signal that was played with one period and buffer size.
+struct pcm_tuning_result
+{
+    pcm_buffering   buffering;
+    bool            supported;      ///< whether the device accepted this buffering at all
+    double          start_latency;  ///< milliseconds from the first write until the device played the first frame
+    unsigned long   underruns;      ///< number of underruns while playing the test signal
+    double          cpu_load;       ///< fraction of a cpu that was used while writing the test signal
+};
+
+std::vector<pcm_tuning_result> measure_buffering(
+        opened_pcm_device &device, const std::vector<pcm_buffering> &candidates, unsigned int rate);
+pcm_buffering tune_buffering( opened_pcm_device &device, unsigned int rate, std::ostream &report);
+
+pcm_buffering read_buffering( const std::string &filename);
+void write_buffering( const std::string &filename, const pcm_buffering &buffering);
+
+#endif /* PCM_TUNER_H_ */
@@ -0,0 +1,402 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "playback_queue.h"
+#include "audio_sink.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/// convert a size in bits into a SND_PCM enum value for use in alsa functions.
+snd_pcm_format_t bitsize_to_pcm_format( unsigned int bitsize)
+{
+    if (bitsize <= 8) return SND_PCM_FORMAT_U8;
+    if (bitsize <= 16) return SND_PCM_FORMAT_S16_LE;
+    if (bitsize <= 24) return SND_PCM_FORMAT_S24_3LE; // wav files pack 24-bit samples in three bytes
+    if (bitsize <= 32) return SND_PCM_FORMAT_S32_LE;
+    throw std::runtime_error( "don't know how to handle samples of bitsize " + std::to_string( bitsize));
+}
+
+/// Write the frames of a waveform to the device. Edge encoded waveforms are expanded on the fly.
+void write_waveform( audio_sink &device, const waveform &wav)
+{
+    if (wav.samples)
+    {
+        device.write( wav.data(), wav.frame_count());
+    }
+    else
+    {
+        device.write_generated( wav.frame_count(),
+                [&wav]( char *destination, snd_pcm_uframes_t offset, snd_pcm_uframes_t count)
+                {
+                    wav.render( destination, offset, count);
+                });
+    }
+}
+
+}
+
+/// Given a riff_fmt object that was the result of parsing a wav-file, determine the pcm device
+/// configuration that is needed to play it. Period and buffer size are left to the device.
+pcm_configuration configuration_from_wav( const riff_fmt &format)
+{
+    return { bitsize_to_pcm_format( format.bits_per_sample), format.samplerate, format.channels, 0, 0};
+}
+
+/// Mark the moment that the first frames of a job are written to the device.
+/// If latencies are given, the completion handler of the job is extended to record the trace of
+/// the job once it has been transmitted.
+void start_trace( playback_job &job, latency_statistics *latencies)
+{
+    job.trace.first_write = std::chrono::steady_clock::now();
+    if (!latencies) return;
+
+    auto trace = job.trace;
+    auto done = std::move( job.on_done);
+    job.on_done = [latencies, trace, done]() mutable
+            {
+                trace.completed = std::chrono::steady_clock::now();
+                latencies->record( trace);
+                if (done) done();
+            };
+}
+
+/// Create a queue that plays to the given device and start its playback thread.
+/// At most 'capacity' jobs can be waiting to be played on every channel. Waveforms that are played back-to-back are
+/// separated by 'gap' of silence. If 'dual' is true, the left and right channel play independent queues of mono
+/// waveforms.
+playback_queue::playback_queue(
+        audio_sink& device, std::size_t capacity, std::chrono::milliseconds gap,
+        bool dual, latency_statistics *latencies)
+:device( device), gap( gap), latencies( latencies)
+{
+    for (int channel = 0; channel < (dual ? 2 : 1); ++channel)
+    {
+        jobs.emplace_back( new job_queue( capacity));
+    }
+    worker = std::thread{ [this](){ run();}};
+}
+
+/// Stop the playback thread. Jobs that are still in the queue will not be played and jobs that are being
+/// played are stopped at the next waveform or period, without being completed.
+playback_queue::~playback_queue()
+{
+    {
+        std::lock_guard<std::mutex> lock( mutex);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    worker.join();
+}
+
+/// Schedule a waveform to be played and return immediately.
+/// This function returns false if the queue is full, in which case the job is discarded.
+bool playback_queue::push( playback_job job)
+{
+    auto &queue = *jobs[ jobs.size() > 1 ? job.channel % jobs.size() : 0];
+    if (!queue.push( std::move( job))) return false;
+
+    // take the lock, so that the notification can't get lost between the
+    // playback thread checking for jobs and starting to wait.
+    std::lock_guard<std::mutex> lock( mutex);
+    wakeup.notify_one();
+    return true;
+}
+
+/// Body of the playback thread: play jobs until the queue is being destroyed.
+void playback_queue::run()
+{
+    if (jobs.size() > 1)
+    {
+        run_dual();
+    }
+    else
+    {
+        run_single();
+    }
+}
+
+/// Play the jobs of a single queue.
+/// Jobs that are queued while the device is still playing are appended to the stream that is already
+/// playing, so that the device does not need to be stopped and restarted for every waveform. The device
+/// is only drained once the queue runs empty, after which the jobs that were played are completed.
+void playback_queue::run_single()
+{
+    playback_job job;
+    completion_list completions;
+    for (;;)
+    {
+        if (!wait_for_job( !completions.empty())) return;
+
+        if (!jobs[0]->pop( job))
+        {
+            // queue is empty, let the device finish playing what it has.
+            finish( completions);
+            continue;
+        }
+
+        try
+        {
+            const auto config = configuration_from_wav( job.wav.fmt);
+            if (!completions.empty())
+            {
+                if (device.has_configuration( config))
+                {
+                    device.write_silence( gap.count() * config.rate / 1000);
+                }
+                else
+                {
+                    // the new waveform can't be appended to the current stream.
+                    finish( completions);
+                }
+            }
+
+            device.configure( config);
+            start_trace( job, latencies);
+            write_waveform( device, job.wav);
+            for (unsigned int repeat = 1; repeat < job.repeats; ++repeat)
+            {
+                device.write_silence( job.repeat_gap.count() * config.rate / 1000);
+                write_waveform( device, job.wav);
+            }
+            completions.push_back( std::move( job.on_done));
+        }
+        catch (std::exception &e)
+        {
+            std::cerr << "error while playing waveform: " << e.what() << std::endl;
+            abandon_stream( completions);
+        }
+    }
+}
+
+/// Play the jobs of two queues simultaneously on the left and right channel of a stereo stream.
+/// The stream is produced one period at a time, so that a job that arrives for an idle channel starts
+/// within a period, even while the other channel is playing. Jobs are completed once their last frame
+/// has passed through the ring buffer of the device.
+void playback_queue::run_dual()
+{
+    struct lane
+    {
+        playback_job    job;
+        std::size_t     position = 0;   ///< next frame of the job to play
+        std::size_t     pause = 0;      ///< frames of silence to play before taking the next job or repeat
+        unsigned int    remaining = 0;  ///< number of repeats of the job that still need to start
+        bool            active = false;
+    };
+
+    lane lanes[2];
+    std::vector<std::int16_t> mono;
+    completion_list completions;
+    std::deque<std::pair<std::uint64_t, std::function<void()>>> pending; // completions with the frame count they wait for
+    std::uint64_t frames_written = 0;
+    bool playing = false;
+    unsigned int rate = 0;
+
+    for (;;)
+    {
+        {
+            // the lanes can keep this loop busy for a long time, so don't wait for them to run idle to stop.
+            std::lock_guard<std::mutex> lock( mutex);
+            if (stopping) return;
+        }
+
+        bool busy = false;
+        for (std::size_t channel = 0; channel < 2; ++channel)
+        {
+            auto &current = lanes[channel];
+            if (!current.active && !current.pause && current.remaining)
+            {
+                // play the same waveform again.
+                --current.remaining;
+                current.active = true;
+                current.position = 0;
+            }
+            else if (!current.active && !current.pause && jobs[channel]->pop( current.job))
+            {
+                current.active = true;
+                current.position = 0;
+                current.remaining = current.job.repeats > 1 ? current.job.repeats - 1 : 0;
+                start_trace( current.job, latencies);
+                if (!playing) rate = current.job.wav.fmt.samplerate;
+            }
+            busy = busy || current.active || current.pause;
+        }
+
+        if (!busy)
+        {
+            if (!wait_for_job( playing)) return;
+            if (playing && !jobs_available())
+            {
+                for (auto &p : pending) completions.push_back( std::move( p.second));
+                pending.clear();
+                finish( completions);
+                playing = false;
+            }
+            continue;
+        }
+
+        try
+        {
+            device.configure( { SND_PCM_FORMAT_S16_LE, rate, 2, 0, 0});
+            const snd_pcm_uframes_t period = device.period_size();
+            mono.resize( period);
+            device.write_generated( period,
+                    [&lanes, &mono]( char *destination, snd_pcm_uframes_t offset, snd_pcm_uframes_t count)
+                    {
+                        const auto output = reinterpret_cast<std::int16_t *>( destination);
+                        for (std::size_t channel = 0; channel < 2; ++channel)
+                        {
+                            const lane &current = lanes[channel];
+                            const std::size_t first = current.position + offset;
+                            const std::size_t available = current.active && first < current.job.wav.frame_count() ?
+                                    std::min<std::size_t>( count, current.job.wav.frame_count() - first) : 0;
+                            if (available) current.job.wav.render( reinterpret_cast<char *>( mono.data()), first, available);
+                            std::fill( mono.begin() + available, mono.begin() + count, 0);
+                            for (std::size_t frame = 0; frame < count; ++frame)
+                            {
+                                output[2 * frame + channel] = mono[frame];
+                            }
+                        }
+                    });
+            playing = true;
+            frames_written += period;
+
+            const std::size_t gap_frames = gap.count() * rate / 1000;
+            for (auto &current : lanes)
+            {
+                if (current.active)
+                {
+                    current.position += period;
+                    if (current.position >= current.job.wav.frame_count() && current.remaining)
+                    {
+                        current.active = false;
+                        current.pause = current.job.repeat_gap.count() * rate / 1000;
+                    }
+                    else if (current.position >= current.job.wav.frame_count())
+                    {
+                        pending.push_back( std::make_pair( frames_written, std::move( current.job.on_done)));
+                        current.active = false;
+                        current.pause = gap_frames;
+                    }
+                }
+                else if (current.pause)
+                {
+                    current.pause = current.pause > period ? current.pause - period : 0;
+                }
+            }
+
+            // complete the jobs whose frames have been played by now.
+            const std::uint64_t buffered = device.delay();
+            while (!pending.empty() && pending.front().first + buffered <= frames_written)
+            {
+                if (pending.front().second) pending.front().second();
+                pending.pop_front();
+            }
+        }
+        catch (std::exception &e)
+        {
+            std::cerr << "error while playing waveforms: " << e.what() << std::endl;
+
+            // abandon the jobs of both channels without completing them, their codes were never transmitted
+            // in full. The jobs whose frames were all written are completed once the device has played them.
+            for (auto &current : lanes)
+            {
+                current.job.on_done = nullptr;
+                current.active = false;
+                current.pause = 0;
+                current.remaining = 0;
+            }
+            for (auto &p : pending) completions.push_back( std::move( p.second));
+            pending.clear();
+            finish( completions);
+            playing = false;
+        }
+    }
+}
+
+/// Wait until a new job is available or until the queue is being destroyed.
+/// If the device is still playing, this function returns in time for a new job to be appended
+/// to the stream before the device runs out of frames.
+/// Returns false if the queue is being destroyed.
+bool playback_queue::wait_for_job( bool playing)
+{
+    std::unique_lock<std::mutex> lock( mutex);
+    const auto ready = [this](){ return stopping || jobs_available();};
+    if (playing)
+    {
+        // leave enough time to write the inter-code gap and the start of the next waveform.
+        const auto buffered = device.delay();
+        const auto margin = (gap.count() + 10) * device.rate() / 1000;
+        if (buffered > margin)
+        {
+            const std::chrono::microseconds timeout{ (buffered - margin) * 1000000LL / device.rate()};
+            wakeup.wait_for( lock, timeout, ready);
+        }
+    }
+    else
+    {
+        wakeup.wait( lock, ready);
+    }
+
+    return !stopping;
+}
+
+/// returns whether any of the queues has a job waiting.
+bool playback_queue::jobs_available() const
+{
+    for (const auto &queue : jobs)
+    {
+        if (queue->read_available()) return true;
+    }
+    return false;
+}
+
+/// Stop the device after a failed write, so that the next job starts a new stream instead of being appended
+/// to the frames of the job that failed. Any frames that the device hadn't played yet are dropped, so the jobs
+/// that were written to the stream before are not completed either: they may not have been transmitted.
+void playback_queue::abandon_stream( completion_list& completions)
+{
+    try
+    {
+        device.drop();
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "error while stopping playback: " << e.what() << std::endl;
+    }
+    completions.clear();
+}
+
+/// Wait for the device to finish playing and invoke the completion handlers of all jobs that were played.
+void playback_queue::finish( completion_list& completions)
+{
+    try
+    {
+        device.drain();
+        device.prepare();
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "error while finishing playback: " << e.what() << std::endl;
+    }
+
+    for (auto &completion : completions)
+    {
+        if (completion) completion();
+    }
+    completions.clear();
+}
+
@@ -0,0 +1,82 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef PLAYBACK_QUEUE_H_
+#define PLAYBACK_QUEUE_H_
+#include "waveform_cache.h"
+#include "latency_histogram.h"
+
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/utility.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class audio_sink;
+struct pcm_configuration;
+
+/// A request to play a single waveform, possibly a number of times in a row.
+struct playback_job
+{
+    waveform              wav;
+    std::function<void()> on_done; ///< invoked on the playback thread after the waveform has been transmitted.
+    unsigned int          channel; ///< output channel to play on, in dual transmitter mode.
+    latency_trace         trace;   ///< timestamps of the command that caused this job.
+    unsigned int          repeats; ///< number of times to play the waveform, 0 counts as once.
+    std::chrono::milliseconds repeat_gap; ///< silence between repeats of the waveform.
+};
+
+pcm_configuration configuration_from_wav( const riff_fmt &format);
+void start_trace( playback_job &job, latency_statistics *latencies);
+
+/// This class plays waveforms to a pcm device on a dedicated thread.
+/// Jobs are handed to the playback thread through a bounded single-producer/single-consumer queue, which
+/// means that push() should always be called from the same thread.
+/// Waveforms that are queued while others are playing are transmitted as one continuous stream, separated
+/// by a configurable gap of silence.
+/// In dual transmitter mode, the left and right channel of the device each drive their own transmitter. Every
+/// channel then has its own queue of 16-bit mono waveforms and both channels play simultaneously.
+/// If the queue is given latency statistics, the trace of every job that was played is recorded in them.
+class playback_queue: boost::noncopyable
+{
+public:
+    playback_queue(
+            audio_sink &device, std::size_t capacity, std::chrono::milliseconds gap,
+            bool dual = false, latency_statistics *latencies = nullptr);
+    ~playback_queue();
+
+    bool push( playback_job job);
+
+private:
+    using completion_list = std::vector<std::function<void()>>;
+    void run();
+    void run_single();
+    void run_dual();
+    bool wait_for_job( bool playing);
+    bool jobs_available() const;
+    void finish( completion_list &completions);
+    void abandon_stream( completion_list &completions);
+
+    using job_queue = boost::lockfree::spsc_queue<playback_job>;
+
+    audio_sink              &device;
+    std::vector<std::unique_ptr<job_queue>> jobs; ///< one queue for every channel that plays independently
+    std::chrono::milliseconds gap;   ///< silence between waveforms that are played back-to-back.
+    latency_statistics      *latencies;///< where to record the latencies of played jobs, may be null.
+    std::mutex              mutex;   ///< protects 'stopping' and is used to wait for new jobs.
+    std::condition_variable wakeup;
+    bool                    stopping = false;
+    std::thread             worker;
+};
+
+#endif /* PLAYBACK_QUEUE_H_ */
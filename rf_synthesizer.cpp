@@ -0,0 +1,155 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "rf_synthesizer.h"
+#include "edge_encoding.h"
+
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+/// Timings of some well known protocols, in the same form as they would appear in a device settings file.
+/// Pulse lengths of symbols and sync are given as multiples of 'pulse'.
+const std::map<std::string, settings_map> builtin_protocols{
+    // PT2262 and compatible encoders, with tri-state address bits.
+    {"pt2262", {
+            {"pulse", "350"}, {"repeats", "8"}, {"sync", "1,31"},
+            {"symbol_0", "1,3,1,3"}, {"symbol_1", "3,1,3,1"}, {"symbol_F", "1,3,3,1"}}},
+    // EV1527 and other learning code encoders.
+    {"ev1527", {
+            {"pulse", "350"}, {"repeats", "8"}, {"sync", "1,31"},
+            {"symbol_0", "1,3"}, {"symbol_1", "3,1"}}},
+    // HT6P20 and similar encoders with a longer base pulse.
+    {"ht6p20", {
+            {"pulse", "650"}, {"repeats", "8"}, {"sync", "1,10"},
+            {"symbol_0", "1,2"}, {"symbol_1", "2,1"}}},
+};
+
+const int16_t high_level = 32767;
+const int16_t low_level  = -32767;
+
+/// Parse a comma separated list of pulse lengths and scale them by the given base pulse length.
+rf_protocol::pulses parse_pulses( const std::string &text, unsigned int pulse)
+{
+    std::vector<std::string> parts;
+    boost::algorithm::split( parts, text, boost::algorithm::is_any_of(","));
+    rf_protocol::pulses result;
+    for (const auto &part : parts)
+    {
+        result.push_back( std::stoul( part) * pulse);
+    }
+    return result;
+}
+}
+
+/// Create a protocol description from the settings of a device.
+/// The settings may name one of the built-in protocols with a "protocol" key. Any timings that are given
+/// in the settings themselves override those of the built-in protocol. Recognized keys are:
+/// "pulse" (base pulse length in microseconds), "repeats", "sync" and "symbol_<c>" for every symbol c that
+/// may appear in a code. Pulse lengths are given as comma separated multiples of the base pulse length.
+rf_protocol rf_protocol_from_settings( const settings_map &settings)
+{
+    settings_map combined = settings;
+    const auto protocol_name = settings.find( "protocol");
+    if (protocol_name != settings.end())
+    {
+        const auto builtin = builtin_protocols.find( protocol_name->second);
+        if (builtin == builtin_protocols.end())
+        {
+            throw std::runtime_error( "unknown RF protocol: " + protocol_name->second);
+        }
+        // insert() does not overwrite, so explicit settings take precedence.
+        combined.insert( builtin->second.begin(), builtin->second.end());
+    }
+
+    const unsigned int pulse = combined.count( "pulse") ? std::stoul( combined["pulse"]) : 1;
+
+    rf_protocol result;
+    static const std::string symbol_prefix = "symbol_";
+    for (const auto &setting : combined)
+    {
+        if (setting.first.size() == symbol_prefix.size() + 1
+                && setting.first.compare( 0, symbol_prefix.size(), symbol_prefix) == 0)
+        {
+            result.symbols[setting.first.back()] = parse_pulses( setting.second, pulse);
+        }
+    }
+
+    if (combined.count( "sync")) result.sync = parse_pulses( combined["sync"], pulse);
+    if (combined.count( "repeats")) result.repeats = std::stoul( combined["repeats"]);
+
+    if (result.symbols.empty()) throw std::runtime_error( "RF protocol does not define any symbols");
+    return result;
+}
+
+/// Create a synthesizer that stores the waveforms it renders in the given cache.
+rf_synthesizer::rf_synthesizer( waveform_cache &cache)
+:cache( cache)
+{
+}
+
+/// Render a code into a 16-bit mono waveform with the given sample rate.
+/// Pulse edges are placed at the sample that is nearest to their exact point in time, so timing errors
+/// don't accumulate over the length of the code. Codes that render to the same samples as an earlier code,
+/// like the same code of two devices, share the waveform that is already in the cache.
+waveform rf_synthesizer::render( const rf_protocol &protocol, const std::string &code, unsigned int samplerate)
+{
+    // collect the durations and levels of all pulses.
+    std::vector<std::pair<unsigned int, bool>> pulses;
+    const auto append = [&pulses]( const rf_protocol::pulses &durations)
+            {
+                bool high = true;
+                for (auto duration : durations)
+                {
+                    pulses.push_back( std::make_pair( duration, high));
+                    high = !high;
+                }
+            };
+
+    for (unsigned int repeat = 0; repeat < protocol.repeats; ++repeat)
+    {
+        for (auto symbol : code)
+        {
+            const auto symbol_pulses = protocol.symbols.find( symbol);
+            if (symbol_pulses == protocol.symbols.end())
+            {
+                throw std::runtime_error( std::string{"RF code contains undefined symbol '"} + symbol + "'");
+            }
+            append( symbol_pulses->second);
+        }
+        append( protocol.sync);
+    }
+
+    std::uint64_t total_time = 0;
+    for (const auto &pulse : pulses) total_time += pulse.first;
+
+    const auto to_frame = [samplerate]( std::uint64_t microseconds)
+            {
+                return static_cast<std::size_t>( (microseconds * samplerate + 500000) / 1000000);
+            };
+
+    waveform::sample_buffer samples( to_frame( total_time) * sizeof( int16_t));
+    const auto output = reinterpret_cast<int16_t *>( samples.data());
+
+    std::uint64_t time = 0;
+    std::size_t frame = 0;
+    for (const auto &pulse : pulses)
+    {
+        time += pulse.first;
+        const auto end = to_frame( time);
+        fill_samples( output + frame, end - frame, pulse.second ? high_level : low_level);
+        frame = end;
+    }
+
+    const riff_fmt fmt{ 1, 1, samplerate, samplerate * 2, 2, 16};
+    return cache.insert( fmt, std::move( samples));
+}
@@ -0,0 +1,44 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef RF_SYNTHESIZER_H_
+#define RF_SYNTHESIZER_H_
+#include "settings_file.h"
+#include "waveform_cache.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+/// Pulse timings of an on/off-keying protocol, like the ones that most cheap 433MHz remote controls use.
+/// Every symbol of a code is transmitted as a sequence of pulses that alternate between high and low,
+/// starting with high. All durations are in microseconds.
+struct rf_protocol
+{
+    using pulses = std::vector<unsigned int>;
+
+    std::map<char, pulses> symbols;     ///< pulses for every symbol that may appear in a code
+    pulses                 sync;        ///< pulses that follow every transmission of the code
+    unsigned int           repeats = 1; ///< number of times that the code is transmitted
+};
+
+rf_protocol rf_protocol_from_settings( const settings_map &settings);
+
+/// This class renders codes of RF protocols into waveforms, as an alternative to recording them.
+/// Rendered waveforms are stored in a waveform cache, which keeps only one copy of identical waveforms.
+class rf_synthesizer
+{
+public:
+    explicit rf_synthesizer( waveform_cache &cache);
+    waveform render( const rf_protocol &protocol, const std::string &code, unsigned int samplerate);
+
+private:
+    waveform_cache &cache;
+};
+
+#endif /* RF_SYNTHESIZER_H_ */
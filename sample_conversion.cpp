@@ -0,0 +1,170 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "sample_conversion.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The conversion is done in three passes over plain arrays: the source samples are widened to 32 bits,
+// then resampled and remapped to the target channels and finally narrowed to the target sample size.
+// Every pass is a simple counted loop without branches in its body, so that the compiler can vectorize it.
+namespace {
+
+/// Widen samples of the given size in bits to signed 32-bit values with the same full scale.
+void widen( const char *source, std::size_t count, unsigned int bits, std::int32_t *destination)
+{
+    const auto bytes = reinterpret_cast<const std::uint8_t *>( source);
+    switch (bits)
+    {
+    case 8: // unsigned
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            destination[i] = static_cast<std::int32_t>( (std::uint32_t{ bytes[i]} ^ 0x80u) << 24);
+        }
+        break;
+    case 16:
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            destination[i] = static_cast<std::int32_t>(
+                    std::uint32_t{ bytes[2 * i]} << 16 | std::uint32_t{ bytes[2 * i + 1]} << 24);
+        }
+        break;
+    case 24: // packed into three bytes
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            destination[i] = static_cast<std::int32_t>(
+                    std::uint32_t{ bytes[3 * i]} << 8 | std::uint32_t{ bytes[3 * i + 1]} << 16
+                    | std::uint32_t{ bytes[3 * i + 2]} << 24);
+        }
+        break;
+    case 32:
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            destination[i] = static_cast<std::int32_t>(
+                    std::uint32_t{ bytes[4 * i]} | std::uint32_t{ bytes[4 * i + 1]} << 8
+                    | std::uint32_t{ bytes[4 * i + 2]} << 16 | std::uint32_t{ bytes[4 * i + 3]} << 24);
+        }
+        break;
+    }
+}
+
+/// Narrow signed 32-bit values to little endian samples of the given size in bits.
+void narrow( const std::int32_t *source, std::size_t count, unsigned int bits, char *destination)
+{
+    const auto bytes = reinterpret_cast<std::uint8_t *>( destination);
+    switch (bits)
+    {
+    case 8:
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            bytes[i] = static_cast<std::uint8_t>( (static_cast<std::uint32_t>( source[i]) >> 24) ^ 0x80u);
+        }
+        break;
+    case 16:
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto value = static_cast<std::uint32_t>( source[i]);
+            bytes[2 * i]     = static_cast<std::uint8_t>( value >> 16);
+            bytes[2 * i + 1] = static_cast<std::uint8_t>( value >> 24);
+        }
+        break;
+    case 24:
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto value = static_cast<std::uint32_t>( source[i]);
+            bytes[3 * i]     = static_cast<std::uint8_t>( value >> 8);
+            bytes[3 * i + 1] = static_cast<std::uint8_t>( value >> 16);
+            bytes[3 * i + 2] = static_cast<std::uint8_t>( value >> 24);
+        }
+        break;
+    case 32:
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const auto value = static_cast<std::uint32_t>( source[i]);
+            bytes[4 * i]     = static_cast<std::uint8_t>( value);
+            bytes[4 * i + 1] = static_cast<std::uint8_t>( value >> 8);
+            bytes[4 * i + 2] = static_cast<std::uint8_t>( value >> 16);
+            bytes[4 * i + 3] = static_cast<std::uint8_t>( value >> 24);
+        }
+        break;
+    }
+}
+}
+
+/// returns whether waveforms in the given format can be converted to and from.
+bool can_convert( const riff_fmt &fmt)
+{
+    const auto bits = fmt.bits_per_sample;
+    return fmt.channels && fmt.samplerate && (bits == 8 || bits == 16 || bits == 24 || bits == 32);
+}
+
+/// Convert 'frames' frames of samples from one format to another.
+/// The sample rate is converted by taking, for every target frame, the source frame that was playing at that
+/// moment. Unlike interpolating resamplers, this keeps the signal at exactly the levels of the original, which
+/// is what the on/off keyed waveforms for RF transmitters need; every edge moves by less than one sample.
+/// Extra target channels repeat the last source channel and surplus source channels are dropped.
+waveform::sample_buffer convert_samples(
+        const riff_fmt &from, const char *samples, std::size_t frames, const riff_fmt &to)
+{
+    if (!can_convert( from) || !can_convert( to))
+    {
+        throw std::runtime_error( "can't convert " + std::to_string( from.bits_per_sample) + " bit samples to "
+                + std::to_string( to.bits_per_sample) + " bits");
+    }
+
+    std::vector<std::int32_t> wide( frames * from.channels);
+    widen( samples, wide.size(), from.bits_per_sample, wide.data());
+
+    const std::size_t target_frames = static_cast<std::size_t>(
+            static_cast<std::uint64_t>( frames) * to.samplerate / from.samplerate);
+    std::vector<std::int32_t> mapped( target_frames * to.channels);
+    for (unsigned int channel = 0; channel < to.channels; ++channel)
+    {
+        const unsigned int source_channel = channel < from.channels ? channel : from.channels - 1;
+        for (std::size_t frame = 0; frame < target_frames; ++frame)
+        {
+            const auto source_frame = static_cast<std::size_t>(
+                    static_cast<std::uint64_t>( frame) * from.samplerate / to.samplerate);
+            mapped[frame * to.channels + channel] = wide[source_frame * from.channels + source_channel];
+        }
+    }
+
+    waveform::sample_buffer result( mapped.size() * (to.bits_per_sample / 8));
+    narrow( mapped.data(), mapped.size(), to.bits_per_sample, result.data());
+    return result;
+}
+
+/// Convert 16-bit mono frames to frames with the channels and sample size of 'to', at the same sample rate.
+/// Every channel gets the same signal, exactly like convert_samples() would produce it. This doesn't allocate,
+/// so that it can be used while playing.
+void spread_mono_samples( const std::int16_t *samples, std::size_t frames, const riff_fmt &to, char *destination)
+{
+    static const std::size_t block_size = 256;
+    std::int32_t wide[block_size];
+    char narrowed[block_size * 4];
+    const std::size_t sample_size = to.bits_per_sample / 8;
+    for (std::size_t first = 0; first < frames; first += block_size)
+    {
+        const auto count = std::min( block_size, frames - first);
+        widen( reinterpret_cast<const char *>( samples + first), count, 16, wide);
+        narrow( wide, count, to.bits_per_sample, narrowed);
+        for (std::size_t frame = 0; frame < count; ++frame)
+        {
+            for (unsigned int channel = 0; channel < to.channels; ++channel)
+            {
+                std::memcpy( destination, narrowed + frame * sample_size, sample_size);
+                destination += sample_size;
+            }
+        }
+    }
+}
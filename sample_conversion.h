@@ -0,0 +1,21 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef SAMPLE_CONVERSION_H_
+#define SAMPLE_CONVERSION_H_
+#include "waveform_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+
+bool can_convert( const riff_fmt &fmt);
+waveform::sample_buffer convert_samples(
+        const riff_fmt &from, const char *samples, std::size_t frames, const riff_fmt &to);
+void spread_mono_samples( const std::int16_t *samples, std::size_t frames, const riff_fmt &to, char *destination);
+
+#endif /* SAMPLE_CONVERSION_H_ */
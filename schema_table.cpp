@@ -0,0 +1,141 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "schema_table.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+using boost::string_view;
+
+/// names of the built-in schemas, at the index of their schema id.
+constexpr const char *builtin_names[] = {
+        "hbeat.request",
+        "hbeat.app",
+        "hbeat.end",
+        "x10.basic",
+        "x10.confirm"
+};
+
+constexpr std::size_t builtin_count = sizeof builtin_names / sizeof builtin_names[0];
+
+/// number of slots in the hash table of built-in schemas.
+constexpr std::size_t slot_count = 16;
+
+constexpr std::size_t length( const char *text)
+{
+    return *text ? 1 + length( text + 1) : 0;
+}
+
+/// 32-bit FNV-1a hash of a string. This is a C++11 constexpr function, hence the recursion.
+constexpr std::uint32_t fnv1a( const char *text, std::size_t size, std::uint32_t hash = 2166136261u)
+{
+    return size ? fnv1a( text + 1, size - 1, (hash ^ static_cast<unsigned char>( *text)) * 16777619u) : hash;
+}
+
+constexpr std::size_t slot_of( const char *text, std::size_t size)
+{
+    return fnv1a( text, size) % slot_count;
+}
+
+constexpr std::size_t builtin_slot( std::size_t index)
+{
+    return slot_of( builtin_names[index], length( builtin_names[index]));
+}
+
+/// returns whether built-in schema 'index' lands in the same slot as any of the built-in schemas after 'other'.
+constexpr bool collides( std::size_t index, std::size_t other)
+{
+    return other < builtin_count
+            && (builtin_slot( index) == builtin_slot( other) || collides( index, other + 1));
+}
+
+constexpr bool is_perfect( std::size_t index = 0)
+{
+    return index == builtin_count || (!collides( index, index + 1) && is_perfect( index + 1));
+}
+
+static_assert( is_perfect(), "built-in schemas must all hash to a different slot, try another slot count");
+
+/// returns the id of the built-in schema that lands in the given slot, or -1 if the slot is empty.
+constexpr int slot_owner( std::size_t slot, std::size_t index = 0)
+{
+    return index == builtin_count ? -1 : builtin_slot( index) == slot ? static_cast<int>( index) : slot_owner( slot, index + 1);
+}
+
+constexpr int slots[slot_count] = {
+        slot_owner( 0),  slot_owner( 1),  slot_owner( 2),  slot_owner( 3),
+        slot_owner( 4),  slot_owner( 5),  slot_owner( 6),  slot_owner( 7),
+        slot_owner( 8),  slot_owner( 9),  slot_owner( 10), slot_owner( 11),
+        slot_owner( 12), slot_owner( 13), slot_owner( 14), slot_owner( 15)
+};
+
+constexpr bool equal( const char *left, const char *right)
+{
+    return *left == *right && (!*left || equal( left + 1, right + 1));
+}
+
+static_assert( equal( builtin_names[xpl::schemas::heartbeat_request], "hbeat.request")
+        && equal( builtin_names[xpl::schemas::heartbeat_app], "hbeat.app")
+        && equal( builtin_names[xpl::schemas::heartbeat_end], "hbeat.end")
+        && equal( builtin_names[xpl::schemas::x10_basic], "x10.basic")
+        && equal( builtin_names[xpl::schemas::x10_confirm], "x10.confirm"),
+        "schema ids must match the order of the built-in names");
+
+/// returns the id of a built-in schema, or schemas::unknown.
+xpl::schema_id find_builtin( string_view schema)
+{
+    const int owner = slots[slot_of( schema.data(), schema.size())];
+    if (owner < 0 || schema != builtin_names[owner]) return xpl::schemas::unknown;
+    return owner;
+}
+}
+
+namespace xpl
+{
+
+/// Determine the message type from the first line of a message.
+message_type_id find_message_type( boost::string_view type)
+{
+    if (type.size() != 8 || !type.starts_with( "xpl-")) return message_type_id::unknown;
+    const auto kind = type.substr( 4);
+    if (kind == "cmnd") return message_type_id::command;
+    if (kind == "stat") return message_type_id::status;
+    if (kind == "trig") return message_type_id::trigger;
+    return message_type_id::unknown;
+}
+
+/// Return the id of a schema, adding the schema to the table if it isn't in it yet.
+schema_id schema_table::intern( const std::string &schema)
+{
+    const auto id = find( schema);
+    if (id != schemas::unknown) return id;
+    registered.push_back( schema);
+    return builtin_count + registered.size() - 1;
+}
+
+/// Return the id of a schema, or schemas::unknown if the schema is neither built-in nor interned.
+/// Only a handful of schemas is ever registered at run time, so those are searched linearly.
+schema_id schema_table::find( boost::string_view schema) const
+{
+    const auto id = find_builtin( schema);
+    if (id != schemas::unknown) return id;
+
+    const auto found = std::find( registered.begin(), registered.end(), schema);
+    if (found == registered.end()) return schemas::unknown;
+    return builtin_count + (found - registered.begin());
+}
+
+std::size_t schema_table::size() const
+{
+    return builtin_count + registered.size();
+}
+
+}
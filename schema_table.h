@@ -0,0 +1,67 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef SCHEMA_TABLE_H_
+#define SCHEMA_TABLE_H_
+#include <boost/utility/string_view.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace xpl
+{
+
+/// The three xpl message types: xpl-cmnd, xpl-stat and xpl-trig, numbered so that they can be used as an index.
+enum class message_type_id
+{
+    command,
+    status,
+    trigger,
+    unknown
+};
+
+/// number of message types, not counting 'unknown'.
+const std::size_t message_type_count = 3;
+
+message_type_id find_message_type( boost::string_view type);
+
+/// Small integer that identifies a message schema, like "x10.basic".
+using schema_id = unsigned int;
+
+/// Ids of the schemas that are known at compile time. Schemas that are registered at run time are
+/// numbered after these.
+namespace schemas
+{
+    const schema_id heartbeat_request   = 0;   ///< hbeat.request
+    const schema_id heartbeat_app       = 1;   ///< hbeat.app
+    const schema_id heartbeat_end       = 2;   ///< hbeat.end
+    const schema_id x10_basic           = 3;   ///< x10.basic
+    const schema_id x10_confirm         = 4;   ///< x10.confirm
+    const schema_id unknown             = ~0u;
+}
+
+/// Maps schema names to schema ids.
+/// The built-in schemas are found through a perfect hash table that is laid out at compile time, other
+/// schemas are added by intern(), typically when a handler is registered for them. Looking up a schema
+/// never allocates, so that incoming messages can be classified before anything is copied out of them.
+class schema_table
+{
+public:
+    schema_id intern( const std::string &schema);
+    schema_id find( boost::string_view schema) const;
+
+    /// returns one more than the highest id in this table.
+    std::size_t size() const;
+
+private:
+    std::vector<std::string> registered; ///< schemas that aren't built-in, in order of their ids
+};
+
+}
+#endif /* SCHEMA_TABLE_H_ */
@@ -0,0 +1,55 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "settings_file.h"
+#include <boost/algorithm/string/trim.hpp>
+#include <fstream>
+#include <stdexcept>
+
+/// Read a file with settings.
+/// Settings files are text files with lines of the form "name=value", much like the body of an xPL message.
+/// Empty lines and lines that start with '#' are ignored, as is whitespace around names and values.
+settings_map read_settings_file( const std::string &filename)
+{
+    using boost::algorithm::trim_copy;
+
+    std::ifstream file( filename);
+    if (!file) throw std::runtime_error( "could not open settings file " + filename);
+
+    settings_map result;
+    std::string line;
+    unsigned int line_number = 0;
+    while (std::getline( file, line))
+    {
+        ++line_number;
+        const auto trimmed = trim_copy( line);
+        if (trimmed.empty() || trimmed[0] == '#') continue;
+
+        const auto equals = trimmed.find( '=');
+        if (equals == std::string::npos)
+        {
+            throw std::runtime_error( filename + ":" + std::to_string( line_number) + ": expected name=value");
+        }
+        result[trim_copy( trimmed.substr( 0, equals))] = trim_copy( trimmed.substr( equals + 1));
+    }
+
+    return result;
+}
+
+/// Write name-value pairs to a file in the format that read_settings_file() reads.
+void write_settings_file( const std::string &filename, const settings_map &settings)
+{
+    std::ofstream file( filename);
+    if (!file) throw std::runtime_error( "could not create settings file " + filename);
+
+    for (const auto &setting : settings)
+    {
+        file << setting.first << '=' << setting.second << '\n';
+    }
+    if (!file) throw std::runtime_error( "could not write settings file " + filename);
+}
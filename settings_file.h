@@ -0,0 +1,20 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef SETTINGS_FILE_H_
+#define SETTINGS_FILE_H_
+#include <map>
+#include <string>
+
+/// name-value pairs as read from a settings file.
+using settings_map = std::map<std::string, std::string>;
+
+settings_map read_settings_file( const std::string &filename);
+void write_settings_file( const std::string &filename, const settings_map &settings);
+
+#endif /* SETTINGS_FILE_H_ */
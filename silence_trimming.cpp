@@ -0,0 +1,155 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "silence_trimming.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+/// Samples between 'lower' and 'upper' are considered silent.
+struct silence_band
+{
+    std::int32_t lower;
+    std::int32_t upper;
+
+    bool is_active( std::int32_t sample) const
+    {
+        return sample < lower || sample > upper;
+    }
+};
+
+/// Read sample 'index' as a signed value, from samples of the given size in bits.
+std::int32_t sample_at( const std::uint8_t *bytes, std::size_t index, unsigned int bits)
+{
+    switch (bits)
+    {
+    case 8:
+        return std::int32_t{ bytes[index]} - 128;
+    case 16:
+        return static_cast<std::int16_t>( bytes[2 * index] | bytes[2 * index + 1] << 8);
+    case 24:
+        return static_cast<std::int32_t>(
+                std::uint32_t{ bytes[3 * index]} << 8 | std::uint32_t{ bytes[3 * index + 1]} << 16
+                | std::uint32_t{ bytes[3 * index + 2]} << 24) >> 8;
+    default:
+        return static_cast<std::int32_t>(
+                std::uint32_t{ bytes[4 * index]} | std::uint32_t{ bytes[4 * index + 1]} << 8
+                | std::uint32_t{ bytes[4 * index + 2]} << 16 | std::uint32_t{ bytes[4 * index + 3]} << 24) >> 8;
+    }
+}
+
+/// Determine the band of silence of a recording: every sample that is closer to zero than a quarter of the
+/// peak amplitude.
+silence_band find_silence_band( const std::uint8_t *bytes, std::size_t count, unsigned int bits)
+{
+    std::int32_t minimum = 0;
+    std::int32_t maximum = 0;
+    std::size_t index = 0;
+#if defined(__SSE2__)
+    if (bits == 16 && count >= 8)
+    {
+        __m128i low = _mm_set1_epi16( 32767);
+        __m128i high = _mm_set1_epi16( -32768);
+        for (; index + 8 <= count; index += 8)
+        {
+            const __m128i block = _mm_loadu_si128( reinterpret_cast<const __m128i *>( bytes + 2 * index));
+            low = _mm_min_epi16( low, block);
+            high = _mm_max_epi16( high, block);
+        }
+        std::int16_t lows[8];
+        std::int16_t highs[8];
+        _mm_storeu_si128( reinterpret_cast<__m128i *>( lows), low);
+        _mm_storeu_si128( reinterpret_cast<__m128i *>( highs), high);
+        minimum = *std::min_element( lows, lows + 8);
+        maximum = *std::max_element( highs, highs + 8);
+    }
+#endif
+    if (!index && count)
+    {
+        minimum = maximum = sample_at( bytes, 0, bits);
+    }
+    for (; index < count; ++index)
+    {
+        const auto sample = sample_at( bytes, index, bits);
+        minimum = std::min( minimum, sample);
+        maximum = std::max( maximum, sample);
+    }
+
+    const std::int32_t peak = std::max( -minimum, maximum);
+    return { -peak / 4, peak / 4};
+}
+
+/// Return the index of the first sample in [begin, end) that is outside the silence band, or 'end'.
+std::size_t first_active( const std::uint8_t *bytes, std::size_t begin, std::size_t end, unsigned int bits, const silence_band &band)
+{
+    std::size_t index = begin;
+#if defined(__SSE2__)
+    if (bits == 16)
+    {
+        const __m128i lower = _mm_set1_epi16( static_cast<std::int16_t>( band.lower));
+        const __m128i upper = _mm_set1_epi16( static_cast<std::int16_t>( band.upper));
+        for (; index + 8 <= end; index += 8)
+        {
+            const __m128i block = _mm_loadu_si128( reinterpret_cast<const __m128i *>( bytes + 2 * index));
+            const __m128i outside = _mm_or_si128( _mm_cmplt_epi16( block, lower), _mm_cmpgt_epi16( block, upper));
+            if (_mm_movemask_epi8( outside)) break;
+        }
+    }
+#endif
+    while (index < end && !band.is_active( sample_at( bytes, index, bits))) ++index;
+    return index;
+}
+
+/// Return the index just past the last sample in [begin, end) that is outside the silence band, or 'begin'.
+std::size_t last_active( const std::uint8_t *bytes, std::size_t begin, std::size_t end, unsigned int bits, const silence_band &band)
+{
+    std::size_t index = end;
+#if defined(__SSE2__)
+    if (bits == 16)
+    {
+        const __m128i lower = _mm_set1_epi16( static_cast<std::int16_t>( band.lower));
+        const __m128i upper = _mm_set1_epi16( static_cast<std::int16_t>( band.upper));
+        for (; index >= begin + 8; index -= 8)
+        {
+            const __m128i block = _mm_loadu_si128( reinterpret_cast<const __m128i *>( bytes + 2 * (index - 8)));
+            const __m128i outside = _mm_or_si128( _mm_cmplt_epi16( block, lower), _mm_cmpgt_epi16( block, upper));
+            if (_mm_movemask_epi8( outside)) break;
+        }
+    }
+#endif
+    while (index > begin && !band.is_active( sample_at( bytes, index - 1, bits))) --index;
+    return index;
+}
+}
+
+/// Find the frames of a recording that contain the signal, leaving out the silence before and after it.
+/// Silence is whatever stays close to zero compared to the loudest sample, so recordings with some noise
+/// are trimmed as well. For 16-bit recordings, which is what most recordings are, the scans compare eight
+/// samples at a time with SSE2.
+/// Recordings without any signal are not trimmed at all.
+active_region find_active_region( const riff_fmt &fmt, const char *samples, std::size_t frames)
+{
+    const auto bits = fmt.bits_per_sample;
+    if (!fmt.channels || (bits != 8 && bits != 16 && bits != 24 && bits != 32)) return { 0, frames};
+
+    const auto bytes = reinterpret_cast<const std::uint8_t *>( samples);
+    const std::size_t count = frames * fmt.channels;
+    const auto band = find_silence_band( bytes, count, bits);
+    if (band.lower == band.upper) return { 0, frames};
+
+    const auto first = first_active( bytes, 0, count, bits, band);
+    if (first == count) return { 0, frames};
+    const auto last = last_active( bytes, first, count, bits, band);
+    return { first / fmt.channels, (last + fmt.channels - 1) / fmt.channels};
+}
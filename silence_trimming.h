@@ -0,0 +1,24 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef SILENCE_TRIMMING_H_
+#define SILENCE_TRIMMING_H_
+#include "audiofiles/include/wav_file.hpp"
+
+#include <cstddef>
+
+/// Range of frames of a recording that contains the actual signal.
+struct active_region
+{
+    std::size_t first;  ///< first frame of the signal
+    std::size_t end;    ///< frame just past the last frame of the signal
+};
+
+active_region find_active_region( const riff_fmt &fmt, const char *samples, std::size_t frames);
+
+#endif /* SILENCE_TRIMMING_H_ */
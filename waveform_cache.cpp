@@ -0,0 +1,235 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "waveform_cache.h"
+#include "audiofiles/include/mapped_wav_file.hpp"
+#include "sample_conversion.h"
+#include "silence_trimming.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+/// 64-bit FNV-1a hash over a range of bytes.
+std::uint64_t fnv1a( const void *data, std::size_t size, std::uint64_t hash = 14695981039346656037ULL)
+{
+    auto bytes = static_cast<const unsigned char *>( data);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/// Create a hash of the format and content of a waveform.
+std::size_t content_hash( const riff_fmt &fmt, const waveform::sample_buffer &samples)
+{
+    auto hash = fnv1a( &fmt.channels, sizeof fmt.channels);
+    hash = fnv1a( &fmt.samplerate, sizeof fmt.samplerate, hash);
+    hash = fnv1a( &fmt.bits_per_sample, sizeof fmt.bits_per_sample, hash);
+    return fnv1a( samples.data(), samples.size(), hash);
+}
+
+bool same_format( const riff_fmt &left, const riff_fmt &right)
+{
+    return left.channels == right.channels
+            && left.samplerate == right.samplerate
+            && left.bits_per_sample == right.bits_per_sample;
+}
+
+bool same_encoding( const edge_encoding &left, const edge_encoding &right)
+{
+    return left.frame_count == right.frame_count
+            && std::equal( std::begin( left.values), std::end( left.values), std::begin( right.values))
+            && left.checkpoints.front().current == right.checkpoints.front().current
+            && left.runs == right.runs;
+}
+
+/// Try to create an edge encoding of the given samples.
+/// Returns nullptr if the samples can't be encoded, if the encoding does not save enough memory to be worth
+/// the trouble or if the expanded encoding deviates too much from the original samples, which happens
+/// when the samples aren't a signal of two or three flat levels.
+std::shared_ptr<const edge_encoding> try_encode( const riff_fmt &fmt, const waveform::sample_buffer &samples)
+{
+    // the encoding must be at least this many times smaller than the samples.
+    static const std::size_t minimum_ratio = 8;
+
+    if (fmt.channels != 1 || fmt.bits_per_sample != 16) return nullptr;
+
+    const auto begin = reinterpret_cast<const std::int16_t *>( samples.data());
+    const auto count = samples.size() / sizeof( std::int16_t);
+    const auto encoding = edge_encode( begin, count);
+    if (!encoding || encoding->memory_size() * minimum_ratio > samples.size()) return nullptr;
+
+    if (!verify_edge_encoding( *encoding, begin, count))
+    {
+        std::cerr << "edge encoding does not reproduce the waveform, keeping the original samples\n";
+        return nullptr;
+    }
+
+    return encoding;
+}
+}
+
+/// Write 'count' frames of this waveform, starting at 'first_frame', to 'destination'.
+void waveform::render( char *destination, std::size_t first_frame, std::size_t count) const
+{
+    if (samples)
+    {
+        std::memcpy( destination, data() + first_frame * frame_size(), count * frame_size());
+    }
+    else if (fmt.channels == 1 && fmt.bits_per_sample == 16)
+    {
+        edges->expand( reinterpret_cast<std::int16_t *>( destination), first_frame, count);
+    }
+    else
+    {
+        // expand the mono signal block by block and spread it over the channels of the format.
+        static const std::size_t block_size = 1024;
+        std::int16_t mono[block_size];
+        for (std::size_t done = 0; done < count; done += block_size)
+        {
+            const auto block = std::min( block_size, count - done);
+            edges->expand( mono, first_frame + done, block);
+            spread_mono_samples( mono, block, fmt, destination + done * frame_size());
+        }
+    }
+}
+
+/// Create a cache that will hold at most 'budget' bytes of sample data.
+/// If 'compress' is true, waveforms will be edge encoded where possible.
+waveform_cache::waveform_cache( std::size_t budget, bool compress)
+:max_size{ budget}, compress{ compress}
+{
+}
+
+/// Convert all waveforms that are added from now on to the given format.
+void waveform_cache::convert_to( const riff_fmt &format)
+{
+    if (!can_convert( format)) throw std::runtime_error( "waveforms can't be converted to the requested format");
+    target = format;
+    convert = true;
+}
+
+/// Cut the silence before and after the signal of all recordings that are loaded from now on, except for
+/// 'guard' of silence on either side.
+void waveform_cache::trim_silence( std::chrono::milliseconds guard)
+{
+    trim = true;
+    trim_guard = guard;
+}
+
+/// Read the wav file with the given name and return its samples.
+/// If a waveform with identical format and samples was loaded before, the returned waveform will
+/// share its samples with that earlier waveform.
+/// This function throws if the file cannot be parsed or if the memory budget would be exceeded.
+waveform waveform_cache::load( const std::string& filename)
+{
+    const mapped_wav_file file( filename);
+    const wav_file &wav = file.get();
+
+    const riff_fmt &fmt = wav.fmt;
+    const std::size_t framesize = fmt.channels * fmt.bits_per_sample / 8;
+    if (!framesize) throw std::runtime_error("file " + filename + " has an invalid sample format");
+
+    // only keep complete frames.
+    auto begin = reinterpret_cast<const char *>( wav.data.samples);
+    auto frames = wav.data.size / framesize;
+
+    if (trim && fmt.samplerate)
+    {
+        const auto region = find_active_region( fmt, begin, frames);
+        const std::size_t guard = trim_guard.count() * fmt.samplerate / 1000;
+        const std::size_t first = region.first > guard ? region.first - guard : 0;
+        const std::size_t end = std::min( frames, region.end + guard);
+        trimmed += std::chrono::microseconds( (frames - (end - first)) * 1000000ULL / fmt.samplerate);
+        begin += first * framesize;
+        frames = end - first;
+    }
+    if (convert && !same_format( fmt, target))
+    {
+        // convert straight from the mapped file.
+        return insert_converted( fmt, begin, frames);
+    }
+    waveform::sample_buffer samples( begin, begin + frames * framesize);
+
+    return insert( fmt, std::move( samples));
+}
+
+/// Add a waveform to the cache.
+/// If an identical waveform is already in the cache, the existing one is returned and the given samples
+/// are discarded.
+waveform waveform_cache::insert( const riff_fmt& fmt, waveform::sample_buffer samples)
+{
+    if (convert && !same_format( fmt, target))
+    {
+        const std::size_t framesize = fmt.channels * fmt.bits_per_sample / 8;
+        return insert_converted( fmt, samples.data(), framesize ? samples.size() / framesize : 0);
+    }
+
+    const auto encoding = compress ? try_encode( fmt, samples) : nullptr;
+    return store( fmt, std::move( samples), encoding);
+}
+
+/// Convert 'frames' frames of samples to the target format and add them to the cache.
+/// Edge encodings only hold 16-bit mono signals, so with compression enabled, a mono waveform is converted to
+/// 16-bit mono at the target sample rate and encoded. That encoding is spread over the channels and sample size
+/// of the target format while playing. Waveforms that can't be encoded are converted to the target format in
+/// full.
+waveform waveform_cache::insert_converted( const riff_fmt &fmt, const char *samples, std::size_t frames)
+{
+    if (compress && fmt.channels == 1)
+    {
+        const riff_fmt mono{ 1, 1, target.samplerate, target.samplerate * 2, 2, 16};
+        auto converted = convert_samples( fmt, samples, frames, mono);
+        const auto encoding = try_encode( mono, converted);
+        if (encoding) return store( target, std::move( converted), encoding);
+    }
+
+    return store( target, convert_samples( fmt, samples, frames, target), nullptr);
+}
+
+/// Add a waveform in its final format, with its encoding if it has one, unless an identical waveform is
+/// already in the cache.
+/// The samples of an encoded waveform are only hashed, to find identical waveforms, and discarded afterwards.
+waveform waveform_cache::store(
+        const riff_fmt &fmt, waveform::sample_buffer samples, std::shared_ptr<const edge_encoding> encoding)
+{
+    const auto hash = content_hash( fmt, samples);
+    const auto range = entries.equal_range( hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const waveform &candidate = it->second;
+        if (!same_format( candidate.fmt, fmt)) continue;
+        if (encoding && candidate.edges && same_encoding( *candidate.edges, *encoding)) return candidate;
+        if (!encoding && candidate.samples && *candidate.samples == samples) return candidate;
+    }
+
+    waveform result{ fmt, nullptr, encoding};
+    if (!encoding)
+    {
+        result.samples = std::make_shared<const waveform::sample_buffer>( std::move( samples));
+    }
+
+    if (used + result.memory_size() > max_size)
+    {
+        throw std::runtime_error( "waveform memory budget of " + std::to_string( max_size) + " bytes exceeded");
+    }
+
+    used += result.memory_size();
+    uncompressed += result.frame_count() * result.frame_size();
+    entries.insert( std::make_pair( hash, result));
+    return result;
+}
@@ -0,0 +1,111 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef WAVEFORM_CACHE_H_
+#define WAVEFORM_CACHE_H_
+#include "audiofiles/include/wav_file.hpp"
+#include "edge_encoding.h"
+
+#include <boost/align/aligned_allocator.hpp>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// The decoded samples of a wav file, together with their format.
+/// The samples are either stored contiguously and aligned, so that they can be handed to a sound device
+/// as they are, or as an edge encoding that is expanded while playing. Edge encodings always hold a 16-bit mono
+/// signal, which is spread over the channels and sample size of the format of the waveform while playing.
+/// Copies of a waveform share the same sample data.
+struct waveform
+{
+    static const std::size_t alignment = 64;
+    using sample_buffer = std::vector<char, boost::alignment::aligned_allocator<char, alignment>>;
+
+    riff_fmt                             fmt;
+    std::shared_ptr<const sample_buffer> samples;///< the samples, or nullptr if the waveform is edge encoded
+    std::shared_ptr<const edge_encoding> edges;  ///< compact form of the samples, if 'samples' is nullptr
+
+    std::size_t frame_size() const
+    {
+        return fmt.channels * fmt.bits_per_sample / 8;
+    }
+
+    std::size_t frame_count() const
+    {
+        return samples ? samples->size() / frame_size() : edges->frame_count;
+    }
+
+    /// the samples of this waveform. Only valid if the waveform is not edge encoded.
+    const char *data() const
+    {
+        return samples->data();
+    }
+
+    /// number of bytes that the sample data of this waveform occupies.
+    std::size_t memory_size() const
+    {
+        return samples ? samples->size() : edges->memory_size();
+    }
+
+    void render( char *destination, std::size_t first_frame, std::size_t count) const;
+};
+
+/// This class loads wav files into memory and makes sure that identical waveforms are stored only once.
+/// The total amount of sample memory that a cache may hold is limited by a budget. Typically, there
+/// is one cache for every sound device.
+/// If compression is enabled, 16-bit mono waveforms are stored as edge encodings whenever that saves
+/// a substantial amount of memory and the encoding expands to the same signal levels as the original.
+/// A cache can be set up to convert all waveforms to a single format when they are added, so that they can
+/// be played without any conversion, and to cut the silence before and after the signal of recordings.
+/// Mono waveforms that are converted are still edge encoded, whatever the number of channels and the sample
+/// size of the target format.
+class waveform_cache
+{
+public:
+    explicit waveform_cache( std::size_t budget, bool compress = true);
+
+    void convert_to( const riff_fmt &format);
+    void trim_silence( std::chrono::milliseconds guard);
+
+    waveform load( const std::string &filename);
+    waveform insert( const riff_fmt &fmt, waveform::sample_buffer samples);
+
+    /// number of bytes of sample data currently held by this cache.
+    std::size_t memory_used() const { return used;}
+
+    /// maximum number of bytes of sample data this cache will hold.
+    std::size_t budget() const { return max_size;}
+
+    /// number of bytes that the waveforms in this cache would occupy without compression.
+    std::size_t uncompressed_size() const { return uncompressed;}
+
+    /// total duration of the silence that was cut from all recordings that were loaded.
+    std::chrono::microseconds trimmed_time() const { return trimmed;}
+
+private:
+    waveform insert_converted( const riff_fmt &fmt, const char *samples, std::size_t frames);
+    waveform store( const riff_fmt &fmt, waveform::sample_buffer samples, std::shared_ptr<const edge_encoding> encoding);
+
+    using waveform_map = std::unordered_multimap< std::size_t, waveform>;
+
+    waveform_map entries;  ///< all unique waveforms, keyed by content hash
+    std::size_t  used = 0;
+    std::size_t  uncompressed = 0;
+    std::size_t  max_size;
+    bool         compress;
+    bool         convert = false;
+    riff_fmt     target;    ///< format that all waveforms are converted to, if 'convert' is true
+    bool         trim = false;
+    std::chrono::milliseconds trim_guard{ 0};  ///< silence to keep around the signal of trimmed recordings
+    std::chrono::microseconds trimmed{ 0};
+};
+
+#endif /* WAVEFORM_CACHE_H_ */
@@ -0,0 +1,113 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "x10_schema.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+using boost::string_view;
+using xpl::x10_command;
+
+struct command_name
+{
+    const char  *name;
+    x10_command command;
+};
+
+/// all x10.basic commands, sorted by name.
+const command_name command_names[] = {
+        { "all_lights_off", x10_command::all_lights_off},
+        { "all_lights_on",  x10_command::all_lights_on},
+        { "all_units_off",  x10_command::all_units_off},
+        { "bright",         x10_command::bright},
+        { "dim",            x10_command::dim},
+        { "extended",       x10_command::extended},
+        { "hail_ack",       x10_command::hail_ack},
+        { "hail_req",       x10_command::hail_req},
+        { "off",            x10_command::off},
+        { "on",             x10_command::on},
+        { "predim1",        x10_command::predim1},
+        { "predim2",        x10_command::predim2},
+        { "select",         x10_command::select},
+        { "status",         x10_command::status},
+        { "status_off",     x10_command::status_off},
+        { "status_on",      x10_command::status_on},
+};
+
+/// Store a single field of an x10.basic body, fields that cheapl doesn't use are skipped.
+void read_field( string_view name, string_view value, xpl::x10_basic &result)
+{
+    if (name == "command")
+    {
+        result.command_text = value;
+        result.command = xpl::find_x10_command( value);
+    }
+    else if (name == "device") result.device = value;
+    else if (name == "house") result.house = value;
+    else if (name == "level") result.level = value;
+    else if (name == "repeat") result.repeat = value;
+}
+
+/// returns whether the body that was read had the fields that every x10.basic message needs.
+bool is_complete( const xpl::x10_basic &result)
+{
+    return result.command_text.data() && result.device.data();
+}
+}
+
+namespace xpl
+{
+
+/// Find a command by its name in an x10.basic message, returns x10_command::unknown for unknown commands.
+x10_command find_x10_command( boost::string_view name)
+{
+    const auto found = std::lower_bound( std::begin( command_names), std::end( command_names), name,
+            []( const command_name &entry, string_view name) { return string_view( entry.name) < name;});
+    if (found == std::end( command_names) || name != found->name) return x10_command::unknown;
+    return found->command;
+}
+
+/// returns the name of a command as it appears in x10.basic messages.
+boost::string_view x10_command_name( x10_command command)
+{
+    for (const auto &entry : command_names)
+    {
+        if (entry.command == command) return entry.name;
+    }
+    return "unknown";
+}
+
+/// Read the body of a message view into its typed form, without copying any text.
+/// If a name appears more than once, the last value counts, just like it does when the view is turned into
+/// a message. Returns false if the body lacks a command or a device.
+bool read_x10_basic( const message_view &view, x10_basic &result)
+{
+    result = x10_basic{};
+    for (std::size_t index = view.header_count; index < view.field_count; ++index)
+    {
+        read_field( view.fields[index].name, view.fields[index].value, result);
+    }
+    return is_complete( result);
+}
+
+/// Read the body of a message into its typed form. The fields refer to the strings of the message.
+/// Returns false if the body lacks a command or a device.
+bool read_x10_basic( const message::map &body, x10_basic &result)
+{
+    result = x10_basic{};
+    for (const auto &field : body)
+    {
+        read_field( field.first, field.second, result);
+    }
+    return is_complete( result);
+}
+
+}
@@ -0,0 +1,62 @@
+//
+//  Copyright (C) 2014 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef X10_SCHEMA_H_
+#define X10_SCHEMA_H_
+#include "datagramparser.h"
+
+#include <boost/utility/string_view.hpp>
+
+namespace xpl
+{
+
+/// The commands of the x10.basic schema. 'on' and 'off' come first, so that they can be used as an index.
+enum class x10_command
+{
+    on,
+    off,
+    dim,
+    bright,
+    all_units_off,
+    all_lights_on,
+    all_lights_off,
+    extended,
+    hail_req,
+    hail_ack,
+    predim1,
+    predim2,
+    status,
+    status_on,
+    status_off,
+    select,
+    unknown
+};
+
+x10_command find_x10_command( boost::string_view name);
+boost::string_view x10_command_name( x10_command command);
+
+/// The body of an x10.basic (or x10.confirm) message, as far as cheapl uses it.
+/// The fields refer to the text of the message_view that they were read from, so they are only valid for
+/// as long as that is. Fields that the message doesn't have are empty.
+struct x10_basic
+{
+    using string_view = boost::string_view;
+
+    x10_command command = x10_command::unknown;
+    string_view command_text;   ///< the command as it appears in the message
+    string_view device;
+    string_view house;
+    string_view level;
+    string_view repeat;         ///< number of times to play the command, a cheapl extension
+};
+
+bool read_x10_basic( const message_view &view, x10_basic &result);
+bool read_x10_basic( const message::map &body, x10_basic &result);
+
+}
+#endif /* X10_SCHEMA_H_ */
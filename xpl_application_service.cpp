@@ -13,11 +13,19 @@
 #include <boost/system/error_code.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/bind.hpp>
+#include <boost/tokenizer.hpp>
 
+#include <sys/socket.h>
+#include <sys/uio.h>
 
+#include <array>
+#include <cerrno>
+#include <chrono>
 #include <iostream>
 #include <iomanip>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace ba = boost::asio;
 namespace bs = boost::system;
@@ -38,33 +46,45 @@ namespace {
     /// discovery period should be at most 120s, or 120/3 heartbeats.
     const int max_discovery_count = 120/discovery_heartbeat_period.seconds();
 
-    // the three xpl message types. xpl-cmnd, xpl-stat or xpl-trig
-    const std::string command_type{"xpl-cmnd"};
-    const std::string status_type{"xpl-stat"};
-    const std::string trigger_type{"xpl-trig"};
+    /// maximum size of an xpl datagram.
+    const std::size_t buffer_size = 512;
 
+    /// maximum number of datagrams that are read from the socket with a single system call.
+    const std::size_t receive_batch_size = 16;
 
-    void map_to_stream( const xpl::message::map &map, std::ostream &stream)
+    /// Strings that outgoing messages are serialized into. Buffers are reused, so that sending a message
+    /// doesn't allocate memory once the pool holds as many buffers as there are messages waiting to be sent.
+    /// Buffers can be acquired and released from any thread.
+    class buffer_pool
     {
-        stream << "{\n";
-        for (const auto &header_value : map)
+    public:
+        /// returns an empty buffer that is owned by the pool.
+        std::string *acquire()
         {
-            stream << header_value.first << '=' << header_value.second << '\n';
+            std::lock_guard<std::mutex> lock( mutex);
+            if (available.empty())
+            {
+                buffers.emplace_back( new std::string);
+                available.push_back( buffers.back().get());
+            }
+            const auto buffer = available.back();
+            available.pop_back();
+            buffer->clear();
+            return buffer;
         }
-        stream << "}\n";
-    }
 
-    /// convert an xpl-message to a string that can be sent as an
-    /// UDP packet.
-    std::string to_string( const xpl::message &m)
-    {
-        std::ostringstream stream;
-        stream << m.message_type << '\n';
-        map_to_stream( m.headers, stream);
-        stream << m.message_schema << '\n';
-        map_to_stream( m.body, stream);
-        return stream.str();
-    }
+        /// return a buffer that was acquired, it may then be handed out again.
+        void release( std::string *buffer)
+        {
+            std::lock_guard<std::mutex> lock( mutex);
+            available.push_back( buffer);
+        }
+
+    private:
+        std::mutex                                  mutex;
+        std::vector<std::unique_ptr<std::string>>   buffers;
+        std::vector<std::string *>                  available;
+    };
 }
 
 namespace xpl
@@ -78,6 +98,24 @@ struct application_service::impl
     {
         socket.set_option(udp::socket::reuse_address(true));
         socket.set_option(ba::socket_base::broadcast(true));
+
+        // every message header of the batch receives into its own buffer.
+        for (std::size_t index = 0; index < receive_batch_size; ++index)
+        {
+            receive_vectors[index].iov_base = receive_buffers[index].data();
+            receive_vectors[index].iov_len = buffer_size;
+            receive_headers[index] = mmsghdr{};
+            receive_headers[index].msg_hdr.msg_iov = &receive_vectors[index];
+            receive_headers[index].msg_hdr.msg_iovlen = 1;
+        }
+
+        // the order of fields in the bodies of the built-in schemas, as the xpl schema definitions give them.
+        const key_order x10_order{ "command", "device", "house", "level", "data1", "data2"};
+        const key_order heartbeat_order{ "interval", "port", "remote-ip", "version"};
+        register_key_order( "x10.basic", x10_order);
+        register_key_order( "x10.confirm", x10_order);
+        register_key_order( "hbeat.app", heartbeat_order);
+        register_key_order( "hbeat.end", heartbeat_order);
     }
 
     static const int hub_port = 3865;
@@ -86,12 +124,67 @@ struct application_service::impl
     udp::endpoint       receive_endpoint{udp::v4(), 0};
     udp::socket         socket{ io_service, receive_endpoint};
     ba::deadline_timer  heartbeat_timer{ io_service};
+    ba::signal_set      signals{ io_service};
+    std::map<int, std::function<void ()>> signal_handlers;
 
     using handler = application_service::handler;
-    using handler_map = std::map< std::string, handler>;
-    using command_handler_map = std::map< std::string, handler_map>;
+    using view_handler = application_service::view_handler;
+
+    /// the handler for a message type and schema, which takes either a message or a message view.
+    /// A view handler can have a message handler too, for messages that don't fit in a view.
+    struct registered_handler
+    {
+        handler         on_message;
+        view_handler    on_view;
+    };
+
+    /// handlers for each message type of a schema.
+    using schema_handlers = std::array<registered_handler, message_type_count>;
 
-    command_handler_map handlers{{command_type, {}}, {status_type, {}},{trigger_type, {}}};;
+    /// Store a handler for a message type and schema, replacing any handler that was there.
+    void register_handler( message_type_id type, const std::string &schema, const registered_handler &h)
+    {
+        const auto id = schemas.intern( schema);
+        if (handlers.size() <= id) handlers.resize( id + 1);
+        handlers[id][static_cast<std::size_t>( type)] = h;
+    }
+
+    /// Store the order in which the body fields of a schema are written.
+    void register_key_order( const std::string &schema, const key_order &order)
+    {
+        const auto id = schemas.intern( schema);
+        if (key_orders.size() <= id) key_orders.resize( id + 1);
+        key_orders[id] = order;
+    }
+
+    /// returns the order of the body fields of a schema, which is empty if no order was registered.
+    const key_order &find_key_order( const std::string &schema) const
+    {
+        static const key_order alphabetical;
+        const auto id = schemas.find( schema);
+        return id < key_orders.size() ? key_orders[id] : alphabetical;
+    }
+
+    /// returns the handler for a message type and schema, or nullptr if there is none.
+    const registered_handler *find_handler( message_type_id type, schema_id schema) const
+    {
+        if (type == message_type_id::unknown || schema >= handlers.size()) return nullptr;
+        const auto &found = handlers[schema][static_cast<std::size_t>( type)];
+        return found.on_message || found.on_view ? &found : nullptr;
+    }
+
+    schema_table                schemas;
+    std::vector<schema_handlers> handlers;  ///< handlers, indexed by schema id
+    std::vector<key_order>      key_orders; ///< order of body fields, indexed by schema id
+
+    buffer_pool                 send_buffers;
+    udp::endpoint               heartbeat_endpoint; ///< local endpoint that the heartbeats were rendered for
+    std::string                 heartbeat_app;      ///< rendered heartbeat message
+    std::string                 heartbeat_end;      ///< rendered final heartbeat message
+
+    std::array<std::array<char, buffer_size>, receive_batch_size> receive_buffers;
+    std::array<iovec, receive_batch_size>   receive_vectors;
+    std::array<mmsghdr, receive_batch_size> receive_headers;
 };
 
 /// Construct a service that will listen for xPL UDP messages.
@@ -179,27 +272,32 @@ void application_service::heartbeat( const boost::system::error_code& e)
  * Send the actual xPL heartbeat message as a UDP broadcast.
  * If the boolean argument "final" is true the heartbeat message will be
  * use the hbeat.end schema, signalling that this service is about to end.
+ * The heartbeat messages only change when the local port or address of the socket changes, so they are
+ * rendered once and rendered again only after such a change.
  */
 void application_service::send_heartbeat_message( bool final)
 {
-    const std::string schema = final?"end":"app";
-    const std::string message =
-            "xpl-stat"                                                  "\n"
-            "{"                                                         "\n"
-            "hop=1"                                                     "\n"
-            "source=" + application_id +                                "\n"
-            "target=*"                                                  "\n"
-            "}"                                                         "\n"
-            "hbeat." + schema +                                         "\n"
-            "{"                                                         "\n"
-            "interval=" + std::to_string( heartbeat_period.minutes() ) +"\n"
-            "port=" + std::to_string( get_listening_port()) +           "\n"
-            "remote-ip=" + get_impl().socket.local_endpoint().address().to_string() + "\n"
-            "version=" + version_string +                               "\n"
-            "}"                                                         "\n";
+    auto &impl = get_impl();
+    const auto local = impl.socket.local_endpoint();
+    if (impl.heartbeat_app.empty() || local != impl.heartbeat_endpoint)
+    {
+        message heartbeat;
+        heartbeat.message_type = "xpl-stat";
+        heartbeat.headers = {{"hop", "1"}, {"target", "*"}};
+        heartbeat.body = {
+                {"interval", std::to_string( heartbeat_period.minutes())},
+                {"port", std::to_string( local.port())},
+                {"remote-ip", local.address().to_string()},
+                {"version", version_string}};
+        heartbeat.message_schema = "hbeat.app";
+        impl.heartbeat_app = render( heartbeat);
+        heartbeat.message_schema = "hbeat.end";
+        impl.heartbeat_end = render( heartbeat);
+        impl.heartbeat_endpoint = local;
+    }
 
     // send the heartbeat message synchronously. throws an error on failure.
-    get_impl().socket.send_to( ba::buffer( message), get_impl().send_endpoint);
+    impl.socket.send_to( ba::buffer( final ? impl.heartbeat_end : impl.heartbeat_app), impl.send_endpoint);
 }
 
 /// Get the UDP port number that this service is listening on.
@@ -241,14 +339,25 @@ void application_service::register_command(
         const std::string& schema,
         application_service::handler h)
 {
-    get_impl().handlers[command_type][schema] = h;
+    get_impl().register_handler( message_type_id::command, schema, { h, nullptr});
+}
+
+/// Register a handler for command messages that takes a view of the message.
+/// Such a handler receives messages without anything being copied out of the datagram that they arrived in,
+/// which makes it the cheapest way to handle frequent commands. The view is only valid while the handler runs.
+/// Messages with more fields than a message view can hold are passed to the 'overflow' handler instead. If
+/// there is no such handler, those messages are dropped with a warning.
+/// @see register_command()
+void application_service::register_command_view( const std::string& schema, view_handler h, handler overflow)
+{
+    get_impl().register_handler( message_type_id::command, schema, { overflow, h});
 }
 
 /// Register a handler for status messages
 /// @see register_command()
 void application_service::register_status( const std::string& schema, application_service::handler h)
 {
-    get_impl().handlers[status_type][schema] = h;
+    get_impl().register_handler( message_type_id::status, schema, { h, nullptr});
 }
 
 /// Register a handler for trigger messages.
@@ -256,78 +365,265 @@ void application_service::register_status( const std::string& schema, applicatio
 void application_service::register_trigger( const std::string& schema,
         application_service::handler h)
 {
-    get_impl().handlers[trigger_type][schema] = h;
+    get_impl().register_handler( message_type_id::trigger, schema, { h, nullptr});
+}
+
+/// Register the order in which the fields of the body of messages with the given schema are sent.
+/// Fields that are not in the list are sent after those that are, in alphabetical order.
+/// The orders of the x10.basic, x10.confirm, hbeat.app and hbeat.end schemas are registered by the service itself.
+void application_service::register_key_order( const std::string &schema, const std::vector<std::string> &keys)
+{
+    get_impl().register_key_order( schema, keys);
+}
+
+/// Return the text of the datagram that send() would send for the given message.
+/// This can be used to prepare messages that are sent often, which can then be sent with send_rendered().
+std::string application_service::render( message m) const
+{
+    m.headers["source"] = application_id;
+    std::string result;
+    serialize( m, result, get_impl().find_key_order( m.message_schema));
+    return result;
 }
 
 /// Schedule a message to be sent and return immediately.
+/// The message is serialized into a buffer from a pool, which is returned to the pool once the message is sent.
 void application_service::send( message m)
 {
     m.headers["source"] = application_id;
 
-    // todo: officially, each xpl message should have its header and body attributes in a specific order. We should
-    // really register this order for each schema type and make sure that they end up in that order in this string.
-    // for now, the members will be ordered alphabetically.
-    std::string as_string = to_string( m);
+    const auto buffer = get_impl().send_buffers.acquire();
+    serialize( m, *buffer, get_impl().find_key_order( m.message_schema));
 
-    get_impl().io_service.post( [as_string, this](){
-        get_impl().socket.send_to( ba::buffer( as_string), get_impl().send_endpoint);
+    get_impl().io_service.post( [buffer, this](){
+        send_datagram( *buffer);
+        get_impl().send_buffers.release( buffer);
     });
 }
 
+/// Schedule a datagram that was prepared with render() to be sent and return immediately.
+/// The datagram is not copied, the service shares it until it has been sent.
+void application_service::send_rendered( std::shared_ptr<const std::string> datagram)
+{
+    get_impl().io_service.post( [datagram, this](){
+        send_datagram( *datagram);
+    });
+}
+
+/// Send a datagram to the hub.
+/// Like any udp datagram, a message that can't be sent is lost, which is reported but doesn't stop the service.
+void application_service::send_datagram( const std::string &datagram)
+{
+    bs::error_code error;
+    get_impl().socket.send_to( ba::buffer( datagram), get_impl().send_endpoint, 0, error);
+    if (error) std::cerr << "could not send message: " << error.message() << '\n';
+}
+
+/// Schedule a function to be executed by the thread that runs this service.
+/// This function may be called from any thread and is the way for other threads to
+/// get things done in the context of this service, like sending messages.
+void application_service::post( std::function<void ()> f)
+{
+    get_impl().io_service.post( f);
+}
+
+/// Return the io_service that runs this service.
+/// Other objects can use it to handle their own events in the same thread as the xPL messages.
+ba::io_service &application_service::get_io_service()
+{
+    return get_impl().io_service;
+}
+
+/// Register a function that will be called whenever the process receives the given signal.
+/// The function is called from the thread that runs this service, so it does not have
+/// the restrictions that normal signal handlers have.
+void application_service::register_signal( int signal_number, std::function<void ()> f)
+{
+    if (get_impl().signal_handlers.empty())
+    {
+        wait_for_signals();
+    }
+    get_impl().signals.add( signal_number);
+    get_impl().signal_handlers[signal_number] = f;
+}
+
+/// Start an asynchronous wait for any of the registered signals.
+void application_service::wait_for_signals()
+{
+    get_impl().signals.async_wait(
+            [this]( const bs::error_code &error, int signal_number)
+            {
+                if (error) return;
+                const auto &handler = get_impl().signal_handlers[signal_number];
+                if (handler) handler();
+                wait_for_signals();
+            });
+}
+
 /// Start an asynchronous read operation.
-/// This starts an operation that will read a message and consequently parse and dispatch to any registered
-/// handlers.
+/// This starts an operation that waits until datagrams are available, then reads all of them and consequently
+/// parses and dispatches them to any registered handlers.
 void application_service::start_read()
 {
-    get_impl().socket.async_receive( ba::buffer( receive_buffer),
-            [this]( const bs::error_code &error, std::size_t bytes_received)
+    get_impl().socket.async_receive( ba::null_buffers(),
+            [this]( const bs::error_code &error, std::size_t)
             {
                 if (error) throw error;
-                using separator_t = boost::char_separator<char>;
-                using tokenizer_t = boost::tokenizer<separator_t, const char *>;
-                tokenizer_t tokenizer( receive_buffer, receive_buffer + bytes_received, separator_t("\n"));
-                datagram_parser parser;
-                for( const auto &line: tokenizer)
-                {
-                    parser.feed_line( line);
-                }
-                if (parser.is_ready())
-                {
-                    handle_message( parser.get_message());
-                }
+                receive_batch();
                 start_read();// start the next read
             });
 }
 
+/// Read and handle all datagrams that are waiting on the socket.
+/// Datagrams are read with recvmmsg(), which reads up to receive_batch_size datagrams in a single system call,
+/// so that a busy network, where every heartbeat reaches every listener, doesn't cost a system call and a
+/// handler invocation for every datagram.
+void application_service::receive_batch()
+{
+    auto &headers = get_impl().receive_headers;
+    for (;;)
+    {
+        const int count = ::recvmmsg(
+                get_impl().socket.native_handle(), headers.data(), headers.size(), MSG_DONTWAIT, nullptr);
+        const auto received = std::chrono::steady_clock::now();
+        if (count < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return;
+            throw bs::system_error( errno, bs::system_category(), "recvmmsg");
+        }
+
+        for (int index = 0; index < count; ++index)
+        {
+            handle_datagram( get_impl().receive_buffers[index].data(), headers[index].msg_len, received);
+        }
+
+        // a partial batch means that the socket has been drained.
+        if (static_cast<std::size_t>( count) < headers.size()) return;
+    }
+}
+
+/// Parse a single datagram and dispatch the message that it contains.
+/// Only the header of the datagram is parsed at first. Most datagrams on an xpl network are not addressed to
+/// this service, or have a schema that it has no handler for, and are dropped before their body is parsed.
+/// The rare datagrams that have more fields than a message_view can hold are parsed line by line instead.
+void application_service::handle_datagram(
+        const char *data, std::size_t size, std::chrono::steady_clock::time_point received)
+{
+    message_view view;
+    if (parse_header( data, size, view))
+    {
+        const auto type = find_message_type( view.message_type);
+        const auto schema = get_impl().schemas.find( view.message_schema);
+        if (!is_relevant( view, type, schema)) return;
+        if (parse_body( view))
+        {
+            view.received = received;
+            view.parsed = std::chrono::steady_clock::now();
+            dispatch( view, type, schema);
+            return;
+        }
+    }
+    if (!view.overflow) return;
+
+    using separator_t = boost::char_separator<char>;
+    using tokenizer_t = boost::tokenizer<separator_t, const char *>;
+    tokenizer_t tokenizer( data, data + size, separator_t("\n"));
+    datagram_parser parser;
+    for( const auto &line: tokenizer)
+    {
+        parser.feed_line( line);
+    }
+    if (!parser.is_ready()) return;
+    message m = parser.get_message();
+    m.received = received;
+    m.parsed = std::chrono::steady_clock::now();
+    handle_message( m);
+}
+
+/// Decide, from the header of a message alone, whether handle_message() would do anything with it.
+/// That is the case if the message is addressed to this service and there is a handler for it, or if it
+/// is the heartbeat of this service that tells that it is connected to a hub.
+bool application_service::is_relevant( const message_view &view, message_type_id type, schema_id schema) const
+{
+    const auto target = view.find_header( "target");
+    if (!target || (target->value != "*" && target->value != application_id)) return false;
+
+    if (!connected && schema == schemas::heartbeat_app)
+    {
+        const auto source = view.find_header( "source");
+        if (source && source->value == application_id) return true;
+    }
+
+    return get_impl().find_handler( type, schema) != nullptr;
+}
+
 /// Deal with an incoming message.
 /// This function will dispatch the given message to any registered handlers for the message schema.
 /// If the message is a heartbeat request, this function will immediately send a heartbeat before dispatching
 /// the message to any registered handler.
 void application_service::handle_message(const xpl::message &m)
 {
-    try
+    dispatch( m, find_message_type( m.message_type), get_impl().schemas.find( m.message_schema));
+}
+
+/// Decide whether a message with the given target is meant for this service.
+/// If the message is the heartbeat of this service itself, we know we've been connected by a hub.
+bool application_service::accept( boost::string_view target, boost::string_view source, schema_id schema)
+{
+    if (target != "*" && target != application_id) return false;
+    if (!connected && schema == schemas::heartbeat_app && source == application_id)
     {
-        const auto &target = m.headers.at("target");
-        // only act if this message was intended for us.
-        if ( target == "*" || target == application_id)
-        {
-            // if we receive our own heartbeat, we know we've been connected by a hub.
-            if (!connected && m.message_schema == "hbeat.app" && m.headers.at("source") == application_id)
-            {
-                connected = true;
-            }
+        connected = true;
+    }
+    return true;
+}
 
-            // find a handler for the message and invoke it.
-            auto handler_it = get_impl().handlers[m.message_type].find(m.message_schema);
-            if (handler_it != get_impl().handlers[m.message_type].end() && handler_it->second)
-            {
-                handler_it->second( m);
-            }
-        }
+/// Dispatch a message of which the type and schema have already been looked up.
+/// Handlers that take a view are given a view of the message, unless the message doesn't fit in one.
+/// Messages without a target are silently ignored.
+void application_service::dispatch( const message &m, message_type_id type, schema_id schema)
+{
+    const auto target = m.headers.find( "target");
+    if (target == m.headers.end()) return;
+    const auto source = m.headers.find( "source");
+    if (!accept( target->second, source == m.headers.end() ? boost::string_view{} : source->second, schema)) return;
+
+    const auto handler = get_impl().find_handler( type, schema);
+    if (!handler) return;
+    message_view view;
+    if (handler->on_view && view_message( m, view))
+    {
+        handler->on_view( view);
+    }
+    else if (handler->on_message)
+    {
+        handler->on_message( m);
+    }
+    else
+    {
+        std::cerr << "dropping " << m.message_schema << " message with " << m.headers.size() + m.body.size()
+                << " fields, handler can't take more than " << message_view::capacity << '\n';
     }
-    catch (std::out_of_range &)
+}
+
+/// Dispatch a message view of which the type and schema have already been looked up.
+/// The view is only turned into a message if the handler takes a message.
+void application_service::dispatch( const message_view &view, message_type_id type, schema_id schema)
+{
+    const auto target = view.find_header( "target");
+    if (!target) return;
+    const auto source = view.find_header( "source");
+    if (!accept( target->value, source ? source->value : boost::string_view{}, schema)) return;
+
+    const auto handler = get_impl().find_handler( type, schema);
+    if (!handler) return;
+    if (handler->on_view)
+    {
+        handler->on_view( view);
+    }
+    else
     {
-        // if any of the 'at()' calls fails, we silently ignore the incoming message.
+        handler->on_message( view.to_message());
     }
 }
 
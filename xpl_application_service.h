@@ -8,16 +8,23 @@
 
 #ifndef XPL_APPLICATION_SERVICE_H_
 #define XPL_APPLICATION_SERVICE_H_
+#include "schema_table.h"
+
 #include <memory>
 #include <functional>
 #include <string>
+#include <vector>
+#include <chrono>
+#include <cstddef>
 
 #include <boost/system/error_code.hpp>
+#include <boost/asio/io_service.hpp>
 
 namespace xpl
 {
 
 class message;
+struct message_view;
 
 /// This class implements a generic xpl application service.
 /// This class will, when the run() member function is called automatically start to broadcast
@@ -39,19 +46,37 @@ public:
     bool is_connected() const {return connected;}
 
     using handler = std::function<void ( const message &)>;
+    using view_handler = std::function<void ( const message_view &)>;
     void register_command( const std::string &schema, handler h);
+    void register_command_view( const std::string &schema, view_handler h, handler overflow = nullptr);
     void register_status(  const std::string &schema, handler h);
     void register_trigger( const std::string &schema, handler h);
+    void register_key_order( const std::string &schema, const std::vector<std::string> &keys);
+    std::string render( message m) const;
     void send( message m);
+    void send_rendered( std::shared_ptr<const std::string> datagram);
     void send_termination_message();
+    void post( std::function<void ()> f);
+    void register_signal( int signal_number, std::function<void ()> f);
+    boost::asio::io_service &get_io_service();
 
 private:
+    friend struct bench_access; ///< lets cheapl_bench measure message handling without a socket
+
+    void send_heartbeat_message( bool final = false);
+    void handle_message( const message &m);
     void discovery_heartbeat( const boost::system::error_code& e, unsigned int counter);
     void heartbeat( const boost::system::error_code& e);
-    void send_heartbeat_message( bool final = false);
     unsigned int get_listening_port() const;
     void start_read();
-    void handle_message( const message &m);
+    void send_datagram( const std::string &datagram);
+    void receive_batch();
+    void handle_datagram( const char *data, std::size_t size, std::chrono::steady_clock::time_point received);
+    bool is_relevant( const message_view &view, message_type_id type, schema_id schema) const;
+    bool accept( boost::string_view target, boost::string_view source, schema_id schema);
+    void dispatch( const message &m, message_type_id type, schema_id schema);
+    void dispatch( const message_view &view, message_type_id type, schema_id schema);
+    void wait_for_signals();
     struct impl;
     impl& get_impl();
     const impl& get_impl() const;
@@ -60,9 +85,6 @@ private:
     bool                    connected{ false};
     const std::string       application_id;
     const std::string       version_string;
-
-    static const size_t buffer_size = 512;
-    char receive_buffer[buffer_size];
 };
 
 }